@@ -0,0 +1,59 @@
+#ifndef MUJOCO_ROS2_CONTROL__ACTUATOR_DYNAMICS_HPP_
+#define MUJOCO_ROS2_CONTROL__ACTUATOR_DYNAMICS_HPP_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mujoco_ros2_control
+{
+struct ActuatorModel
+{
+  double time_constant {0.0};  // first-order lag in seconds
+  double rate_limit {0.0};  // largest change of the command per second, unlimited if not positive
+  double delay {0.0};  // transport delay in seconds, rounded to whole steps
+
+  // Reads <prefix>_time_constant, <prefix>_rate_limit and <prefix>_delay from component parameters
+  static ActuatorModel from_parameters(
+    const std::unordered_map<std::string, std::string> & parameters, const std::string & prefix);
+};
+
+// Turns commands into what an actuator delivers: saturates them, delays them through a ring
+// buffer per channel, passes them through a first-order lag and limits their rate of change.
+// Channels are stored as parallel arrays and go through the same loop. A channel without lag and
+// rate limit keeps no state and passes its saturated, delayed command through. All storage is
+// allocated by add().
+class ActuatorDynamics
+{
+public:
+  // Adds a channel whose output goes to *output on every apply() and returns its index. The
+  // command starts at *output. sample_period is the time between two applies, the simulation
+  // timestep, the delay line and the lag are discretized with it.
+  size_t add(double* output, const ActuatorModel & model, double min, double max, double sample_period);
+  // Where the commands of a channel are written to, valid once all channels have been added
+  double* get_input(size_t channel);
+  // Starts a channel over from value, e.g. when a controller takes over the interface
+  void reset(size_t channel, double value);
+  // Starts all channels over from their commands, e.g. after the simulation has been reset
+  void reset();
+  // Advances all channels by one sample period
+  void apply();
+
+private:
+  std::vector<double> inputs_;
+  std::vector<double*> outputs_;
+  std::vector<double> states_;
+  // weight of the new command in the lag and largest change per sample
+  std::vector<double> lag_factors_;
+  std::vector<double> max_changes_;
+  std::vector<double> mins_;
+  std::vector<double> maxs_;
+  // delay line of each channel in line_samples_, the oldest command at the head
+  std::vector<size_t> line_begins_;
+  std::vector<size_t> line_sizes_;
+  std::vector<size_t> line_heads_;
+  std::vector<double> line_samples_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__ACTUATOR_DYNAMICS_HPP_
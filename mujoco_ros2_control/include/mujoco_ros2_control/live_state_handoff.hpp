@@ -0,0 +1,60 @@
+#ifndef MUJOCO_ROS2_CONTROL__LIVE_STATE_HANDOFF_HPP_
+#define MUJOCO_ROS2_CONTROL__LIVE_STATE_HANDOFF_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace mujoco_ros2_control
+{
+// Hands a copy of the live simulation state over to another thread on request. The simulation
+// thread only checks an atomic flag after each step and copies the state when it is set, so it
+// never waits for the requester. The copy is guarded by mutex(), which readers of it must hold.
+class LiveStateHandoff
+{
+public:
+  LiveStateHandoff()
+    : requested_(false)
+  {
+  }
+
+  // Called from the simulation thread after each step, runs copy() under the mutex when requested
+  template <typename Copy>
+  void serve(Copy copy)
+  {
+    if (!requested_.load(std::memory_order_acquire))
+    {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      copy();
+      requested_.store(false, std::memory_order_release);
+    }
+    cv_.notify_all();
+  }
+
+  // Waits up to a second for the simulation thread to copy its live state, returns false on timeout.
+  // Must not be called from the simulation thread.
+  bool request()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    requested_.store(true, std::memory_order_release);
+    return cv_.wait_for(lock, std::chrono::seconds(1),
+      [this]() { return !requested_.load(std::memory_order_acquire); });
+  }
+
+  std::mutex & mutex()
+  {
+    return mutex_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::atomic<bool> requested_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__LIVE_STATE_HANDOFF_HPP_
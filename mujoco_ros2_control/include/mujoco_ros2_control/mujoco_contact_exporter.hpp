@@ -0,0 +1,51 @@
+#ifndef MUJOCO_ROS2_CONTROL__MUJOCO_CONTACT_EXPORTER_HPP_
+#define MUJOCO_ROS2_CONTROL__MUJOCO_CONTACT_EXPORTER_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "mujoco_ros2_control_msgs/msg/contact_array.hpp"
+
+#include "mujoco/mujoco.h"
+
+#include "mujoco_ros2_control/mujoco_name_index.hpp"
+
+namespace mujoco_ros2_control
+{
+// Publishes the contacts of the last step and the wrenches they transmit on ~/contacts.
+// Contacts can be restricted to bodies, geoms or pairs of bodies, and are published at a
+// decimated rate from a single message reused between publications.
+class MujocoContactExporter
+{
+public:
+  MujocoContactExporter(
+    rclcpp::Node::SharedPtr & node, const mjModel* mujoco_model, const mjData* mujoco_data,
+    const MujocoNameIndex & name_index, double publish_rate);
+  // Must be called after mj_step2, when the constraint forces of the step are known
+  void update(const rclcpp::Time & sim_time);
+
+private:
+  bool is_selected(const mjContact & contact) const;
+
+  rclcpp::Logger logger_;
+  const mjModel* mj_model_;
+  const mjData* mj_data_;
+
+  bool filtered_;
+  std::vector<char> body_selected_;
+  std::vector<char> geom_selected_;
+  std::vector<std::pair<int, int>> body_pairs_;
+  std::vector<std::string> body_names_;
+  std::vector<std::string> geom_names_;
+  std::vector<int> selected_contacts_;
+
+  rclcpp::Duration publish_period_;
+  rclcpp::Time last_publish_time_;
+  rclcpp::Publisher<mujoco_ros2_control_msgs::msg::ContactArray>::SharedPtr contact_publisher_;
+  mujoco_ros2_control_msgs::msg::ContactArray contact_msg_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__MUJOCO_CONTACT_EXPORTER_HPP_
@@ -0,0 +1,78 @@
+#ifndef MUJOCO_ROS2_CONTROL__MUJOCO_LINEARIZER_HPP_
+#define MUJOCO_ROS2_CONTROL__MUJOCO_LINEARIZER_HPP_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "mujoco_ros2_control_msgs/srv/linearize.hpp"
+
+#include "mujoco/mujoco.h"
+
+#include "mujoco_ros2_control/live_state_handoff.hpp"
+#include "mujoco_ros2_control/mujoco_system_interface.hpp"
+
+namespace mujoco_ros2_control
+{
+// Linearizes one simulation step around the current or a given state with mjd_transitionFD, e.g.
+// for model predictive controllers. The finite differences run on a copy of the live state in a
+// scratch mjData, so the simulation is neither modified nor blocked.
+// The inputs are the MuJoCo actuators followed by the effort command interfaces, which drive
+// qfrc_applied and are perturbed separately, since mjd_transitionFD only covers ctrl.
+class MujocoLinearizer
+{
+public:
+  // effort_inputs are the effort command interfaces of the hardware components
+  MujocoLinearizer(
+    rclcpp::Node::SharedPtr & node, const mjModel* mujoco_model, const mjData* mujoco_data,
+    const std::vector<MujocoSystemInterface::EffortInput> & effort_inputs);
+  ~MujocoLinearizer();
+  // Callback group of the service, to be spun by an executor
+  rclcpp::CallbackGroup::SharedPtr get_callback_group() const;
+  // Called from the simulation thread after each step, copies the live state when requested
+  void update();
+  // Waits up to a second for the simulation thread to copy its live state, returns false on timeout.
+  // Must not be called from the simulation thread.
+  bool request_live_state();
+  // Names of the inputs, the actuators followed by the effort command interfaces
+  const std::vector<std::string> & get_input_names() const;
+  // Linearizes around the last copied live state, with qpos, qvel, act and ctrl replaced by the
+  // arguments which are not empty. a is row-major nx x nx and b nx x ni, with nx = 2 * nv + na
+  // and ni the number of inputs.
+  bool linearize(
+    const std::vector<double> & qpos, const std::vector<double> & qvel, const std::vector<double> & act,
+    const std::vector<double> & ctrl, double eps, bool centered, std::vector<mjtNum> & a, std::vector<mjtNum> & b,
+    std::string & error);
+
+private:
+  void service_callback(
+    const mujoco_ros2_control_msgs::srv::Linearize::Request::SharedPtr request,
+    mujoco_ros2_control_msgs::srv::Linearize::Response::SharedPtr response);
+  // Steps the scratch data from scratch_state_ with the given qfrc_applied perturbation and
+  // stores the resulting qpos, qvel and act
+  void step_perturbed(int dof, mjtNum perturbation, std::vector<mjtNum> & qpos, std::vector<mjtNum> & next);
+
+  rclcpp::Logger logger_;
+  const mjModel* mj_model_;
+  const mjData* mj_data_;
+
+  // live state, copied by the simulation thread on request
+  LiveStateHandoff live_state_handoff_;
+  std::vector<mjtNum> live_state_;
+
+  // one linearization at a time on the scratch data
+  std::mutex scratch_mutex_;
+  mjData* scratch_data_;
+  std::vector<mjtNum> scratch_state_;
+
+  std::vector<std::string> input_names_;
+  // DOFs of qfrc_applied driven by the effort inputs
+  std::vector<int> effort_dofs_;
+
+  rclcpp::CallbackGroup::SharedPtr callback_group_;
+  rclcpp::Service<mujoco_ros2_control_msgs::srv::Linearize>::SharedPtr service_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__MUJOCO_LINEARIZER_HPP_
@@ -0,0 +1,43 @@
+#ifndef MUJOCO_ROS2_CONTROL__MUJOCO_MODEL_OPTIONS_HPP_
+#define MUJOCO_ROS2_CONTROL__MUJOCO_MODEL_OPTIONS_HPP_
+
+#include <cstddef>
+#include <string>
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "mujoco/mujoco.h"
+
+namespace mujoco_ros2_control
+{
+// Loads a binary model (.mjb) or compiles an MJCF file, returns nullptr and sets error on failure
+mjModel* load_model(const std::string & path, std::string & error);
+// Overrides the solver options of mjModel::opt with the ones given as node parameters, the
+// options which are not given keep the value of the model. Must be called before mj_makeData.
+void apply_solver_options(rclcpp::Node::SharedPtr & node, mjModel* mujoco_model);
+// Name of a mjtSolver as accepted by the solver parameter
+const char* get_solver_name(int solver);
+
+// Thread pool sized by the mujoco_threads parameter and bound to the data for its lifetime.
+// The data must be deleted before the pool. Without the parameter, or with MuJoCo versions
+// which have no thread pool, nothing is created and the data is processed on the calling thread.
+class MujocoThreadPool
+{
+public:
+  MujocoThreadPool(rclcpp::Node::SharedPtr & node, mjData* mujoco_data);
+  ~MujocoThreadPool();
+  MujocoThreadPool(const MujocoThreadPool &) = delete;
+  MujocoThreadPool & operator=(const MujocoThreadPool &) = delete;
+  size_t size() const;
+  // Binds the pool to another data, e.g. after the model has been reloaded
+  void bind(mjData* mujoco_data);
+
+private:
+  size_t size_;
+#if mjVERSION_HEADER >= 310
+  mjThreadPool* thread_pool_;
+#endif
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__MUJOCO_MODEL_OPTIONS_HPP_
@@ -0,0 +1,107 @@
+#ifndef MUJOCO_ROS2_CONTROL__MUJOCO_MODEL_QUERY_HPP_
+#define MUJOCO_ROS2_CONTROL__MUJOCO_MODEL_QUERY_HPP_
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "mujoco/mujoco.h"
+
+namespace mujoco_ros2_control
+{
+// Kinematics and dynamics queries on the current state of the simulation, from any thread.
+// Each running query borrows a scratch mjData from a pool, synchronized with a snapshot of the live
+// state taken after each step. Results are cached on the scratch data until the next step, so
+// queries within a step share one computation and never block the step loop. The pool holds as
+// many scratch data as queries ever ran at the same time.
+class MujocoModelQuery
+{
+public:
+  // Must be constructed from the simulation thread
+  MujocoModelQuery(const mjModel* mujoco_model, const mjData* mujoco_data);
+  ~MujocoModelQuery();
+  // Called from the simulation thread after each step, takes a snapshot of the live state
+  void update();
+  // Called from the simulation thread when the model is reloaded, waits for the running queries.
+  // Ids of the previous model must be looked up again.
+  void rebind(const mjModel* mujoco_model, const mjData* mujoco_data);
+
+  // Ids to pass to the queries, -1 if the name is unknown
+  int get_body_id(const std::string & name) const;
+  int get_site_id(const std::string & name) const;
+
+  // Simulation time of the state the queries are computed on
+  double get_time();
+  // Position and orientation of a body in the world frame
+  void get_body_pose(int body_id, mjtNum position[3], mjtNum quaternion[4]);
+  // Position and orientation (row-major 3x3) of a site in the world frame
+  void get_site_pose(int site_id, mjtNum position[3], mjtNum rotation[9]);
+  // Translational and rotational Jacobians of a site, each row-major 3 x nv
+  void get_site_jacobian(int site_id, std::vector<mjtNum> & jacp, std::vector<mjtNum> & jacr);
+  // Gravity, Coriolis and centrifugal forces in joint space, nv
+  void get_bias_forces(std::vector<mjtNum> & qfrc_bias);
+  // Joint forces producing the accelerations of the last step, including contacts and constraints, nv
+  void get_inverse_dynamics(std::vector<mjtNum> & qfrc_inverse);
+  // Joint forces producing the given accelerations from the current state, nv. Returns false if
+  // qacc does not have nv elements.
+  bool get_inverse_dynamics(const std::vector<mjtNum> & qacc, std::vector<mjtNum> & qfrc_inverse);
+
+private:
+  // stages computed on the scratch data since it was last synchronized
+  enum Stage
+  {
+    POSITION = 1,
+    VELOCITY = 2,
+    INVERSE = 4
+  };
+
+  struct Scratch
+  {
+    mjData* data;
+    long tick;
+    int stages;
+  };
+
+  // A scratch data checked out of the pool for the lifetime of a query
+  class ScratchLease
+  {
+  public:
+    ScratchLease(MujocoModelQuery & query, int stages);
+    ~ScratchLease();
+    ScratchLease(const ScratchLease &) = delete;
+    ScratchLease & operator=(const ScratchLease &) = delete;
+    Scratch & get() const;
+
+  private:
+    MujocoModelQuery & query_;
+    // keeps the model from being rebound while the scratch data is in use
+    std::shared_lock<std::shared_mutex> model_lock_;
+    Scratch* scratch_;
+  };
+
+  // exclusive while the model is rebound, shared by the queries
+  mutable std::shared_mutex model_mutex_;
+  const mjModel* mj_model_;
+  const mjData* mj_data_;
+
+  // snapshot of the live state, taken by the simulation thread
+  std::mutex snapshot_mutex_;
+  long tick_;
+  mjtNum time_;
+  std::vector<mjtNum> qpos_;
+  std::vector<mjtNum> qvel_;
+  std::vector<mjtNum> qacc_;
+  std::vector<mjtNum> act_;
+  std::vector<mjtNum> mocap_pos_;
+  std::vector<mjtNum> mocap_quat_;
+
+  std::mutex scratch_mutex_;
+  std::vector<std::unique_ptr<Scratch>> scratches_;
+  // the most recently returned last, it is the most likely to be synchronized already
+  std::vector<Scratch*> free_scratches_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__MUJOCO_MODEL_QUERY_HPP_
@@ -0,0 +1,28 @@
+#ifndef MUJOCO_ROS2_CONTROL__MUJOCO_NAME_INDEX_HPP_
+#define MUJOCO_ROS2_CONTROL__MUJOCO_NAME_INDEX_HPP_
+
+#include <string>
+#include <unordered_map>
+
+#include "mujoco/mujoco.h"
+
+namespace mujoco_ros2_control
+{
+// Hash index over the names of MuJoCo objects, built once per model and shared by all hardware
+// components, since mj_name2id scans the names linearly.
+class MujocoNameIndex
+{
+public:
+  explicit MujocoNameIndex(const mjModel* mujoco_model);
+  // Returns the id of the named object, or -1 if there is none, like mj_name2id
+  int get_id(mjtObj type, const std::string & name) const;
+
+private:
+  void add_objects(mjtObj type, int count);
+
+  const mjModel* mj_model_;
+  std::unordered_map<int, std::unordered_map<std::string, int>> ids_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__MUJOCO_NAME_INDEX_HPP_
@@ -0,0 +1,53 @@
+#ifndef MUJOCO_ROS2_CONTROL__MUJOCO_POSE_PUBLISHER_HPP_
+#define MUJOCO_ROS2_CONTROL__MUJOCO_POSE_PUBLISHER_HPP_
+
+#include <string>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "nav_msgs/msg/odometry.hpp"
+#include "tf2_msgs/msg/tf_message.hpp"
+
+#include "mujoco/mujoco.h"
+
+#include "mujoco_ros2_control/mujoco_name_index.hpp"
+
+namespace mujoco_ros2_control
+{
+// Publishes the poses of bodies on /tf and ground-truth odometry of selected bodies, straight
+// from the simulated kinematics. All transforms go out in a single message, both messages are
+// allocated once and only refilled at the publish rate.
+class MujocoPosePublisher
+{
+public:
+  MujocoPosePublisher(
+    rclcpp::Node::SharedPtr & node, const mjModel* mujoco_model, const mjData* mujoco_data,
+    const MujocoNameIndex & name_index, double publish_rate);
+  // Must be called after mj_step2 with the time of the step, which xpos and cvel belong to
+  void update(const rclcpp::Time & sim_time);
+
+private:
+  struct OdometryBody
+  {
+    int mj_body_id;
+    rclcpp::Publisher<nav_msgs::msg::Odometry>::SharedPtr publisher;
+    nav_msgs::msg::Odometry msg;
+  };
+
+  rclcpp::Logger logger_;
+  const mjModel* mj_model_;
+  const mjData* mj_data_;
+
+  // bodies on /tf and the closest of their ancestors on /tf, or the world
+  std::vector<int> tf_bodies_;
+  std::vector<int> tf_parents_;
+  std::vector<OdometryBody> odometry_bodies_;
+
+  rclcpp::Duration publish_period_;
+  rclcpp::Time last_publish_time_;
+  rclcpp::Publisher<tf2_msgs::msg::TFMessage>::SharedPtr tf_publisher_;
+  tf2_msgs::msg::TFMessage tf_msg_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__MUJOCO_POSE_PUBLISHER_HPP_
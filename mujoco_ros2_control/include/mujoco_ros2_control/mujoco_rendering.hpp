@@ -15,6 +15,8 @@ public:
 
   static MujocoRendering* get_instance();
   void init(rclcpp::Node::SharedPtr & node, mjModel* mujoco_model, mjData* mujoco_data);
+  // Renders another model from now on, the window and the camera are kept
+  void reload(mjModel* mujoco_model, mjData* mujoco_data);
   bool is_close_flag_raised();
   void update();
   void close();
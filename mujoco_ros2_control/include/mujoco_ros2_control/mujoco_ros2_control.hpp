@@ -1,14 +1,30 @@
 #ifndef MUJOCO_ROS2_CONTROL__MUJOCO_ROS2_CONTROL_HPP_
 #define MUJOCO_ROS2_CONTROL__MUJOCO_ROS2_CONTROL_HPP_
 
+#include <sched.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
 #include "rclcpp/rclcpp.hpp"
 #include "pluginlib/class_loader.hpp"
 #include "controller_manager/controller_manager.hpp"
 #include "rosgraph_msgs/msg/clock.hpp"
+#include "mujoco_ros2_control_msgs/srv/dump_trace.hpp"
+#include "mujoco_ros2_control_msgs/srv/reload_model.hpp"
 
 #include "mujoco/mujoco.h"
 
 #include "mujoco_ros2_control/mujoco_system.hpp"
+#include "mujoco_ros2_control/mujoco_contact_exporter.hpp"
+#include "mujoco_ros2_control/mujoco_pose_publisher.hpp"
+#include "mujoco_ros2_control/mujoco_wrench_injector.hpp"
+#include "mujoco_ros2_control/mujoco_state_validator.hpp"
+#include "mujoco_ros2_control/mujoco_model_query.hpp"
+#include "mujoco_ros2_control/mujoco_linearizer.hpp"
+#include "mujoco_ros2_control/mujoco_tracer.hpp"
 
 namespace mujoco_ros2_control
 {
@@ -17,10 +33,50 @@ class MujocoRos2Control
 public:
   MujocoRos2Control(rclcpp::Node::SharedPtr & node, mjModel* mujoco_model, mjData* mujoco_data);
   ~MujocoRos2Control();
-  void init();
+  bool init();
   void update();
+  // Loads, configures and activates controllers in-process. Must be called from the thread
+  // running update(), since the controller manager hands them over to the control loop.
+  bool activate_controllers(const std::vector<std::string> & controller_names);
+  // Publishes /clock only every decimation-th update
+  void set_clock_decimation(int decimation);
+  // Batched collision checking against the simulated geometry, nullptr unless enabled
+  MujocoStateValidator* get_state_validator() const;
+  // Kinematics and dynamics queries on the current state, nullptr unless enabled. It stays valid
+  // when the model is reloaded.
+  MujocoModelQuery* get_model_query() const;
+  // Finite-difference linearization of the simulated dynamics, nullptr unless enabled
+  MujocoLinearizer* get_linearizer() const;
+  // Called from update() once a reloaded model has replaced the current one, with the new model
+  // and data, which the caller has to delete in the end instead of the ones it passed in. The
+  // replaced model and data are deleted right after the callback, as are the components returned
+  // by the getters above, which are created again for the new model.
+  void set_model_reload_callback(std::function<void(mjModel*, mjData*)> callback);
+  // Records the phases of the simulation loop, nullptr unless enabled
+  MujocoTracer* get_tracer() const;
 
 private:
+  rclcpp::Time get_sim_time() const;
+  void create_components(const MujocoNameIndex & name_index);
+  // callback groups of the components, spun by services_executor_
+  std::vector<rclcpp::CallbackGroup::SharedPtr> get_callback_groups() const;
+  void reload_model_callback(
+    const mujoco_ros2_control_msgs::srv::ReloadModel::Request::SharedPtr request,
+    mujoco_ros2_control_msgs::srv::ReloadModel::Response::SharedPtr response);
+  void apply_model_reload();
+  void dump_trace_callback(
+    const mujoco_ros2_control_msgs::srv::DumpTrace::Request::SharedPtr request,
+    mujoco_ros2_control_msgs::srv::DumpTrace::Response::SharedPtr response);
+  void settle();
+  bool load_snapshot(const std::string & path, const std::vector<mjtNum> & fingerprint, std::vector<mjtNum> & state);
+  void save_snapshot(const std::string & path, const std::vector<mjtNum> & fingerprint, const std::vector<mjtNum> & state);
+  void configure_realtime();
+  void configure_thread(const std::string & thread_name, int priority, int cpu);
+  rclcpp::Executor::SharedPtr create_executor();
+  void latch_commands();
+  void run_control_thread();
+  void start_control_update(const rclcpp::Time & time, const rclcpp::Duration & period);
+  void wait_control_update();
   void publish_sim_time(rclcpp::Time sim_time);
   rclcpp::Node::SharedPtr node_;  // TODO: delete node
   mjModel* mj_model_;
@@ -30,13 +86,57 @@ private:
   std::shared_ptr<pluginlib::ClassLoader<MujocoSystemInterface>> robot_hw_sim_loader_;
 
   std::shared_ptr<controller_manager::ControllerManager> controller_manager_;
-  rclcpp::executors::MultiThreadedExecutor::SharedPtr cm_executor_;
+  std::vector<MujocoSystemInterface*> mujoco_systems_;
+  rclcpp::Executor::SharedPtr cm_executor_;
   std::thread cm_thread_;
-  bool stop_cm_thread_;
+  int cm_thread_priority_;
+  int cm_thread_cpu_;
+  // services of the components and of the node, which may block for a while, e.g. waiting for the
+  // live state, and must not stall the controller manager
+  rclcpp::Executor::SharedPtr services_executor_;
+  std::thread services_thread_;
+  int sim_thread_priority_;
+  int sim_thread_cpu_;
+  cpu_set_t default_cpu_set_;
   rclcpp::Duration control_period_;
 
   rclcpp::Time last_update_sim_time_ros_;
+  bool publish_clock_;
+  int clock_decimation_;
+  int clock_counter_;
   rclcpp::Publisher<rosgraph_msgs::msg::Clock>::SharedPtr clock_publisher_;
+
+  // pipelined control, the controllers are updated on control_thread_ next to the physics
+  bool pipelined_control_;
+  std::thread control_thread_;
+  std::mutex control_mutex_;
+  std::condition_variable control_cv_;
+  bool control_update_pending_;
+  bool stop_control_thread_;
+  rclcpp::Time control_update_time_;
+  rclcpp::Duration control_update_period_;
+
+  std::unique_ptr<MujocoContactExporter> contact_exporter_;
+  std::unique_ptr<MujocoPosePublisher> pose_publisher_;
+  std::unique_ptr<MujocoWrenchInjector> wrench_injector_;
+  std::unique_ptr<MujocoStateValidator> state_validator_;
+  std::unique_ptr<MujocoModelQuery> model_query_;
+  std::unique_ptr<MujocoLinearizer> linearizer_;
+
+  // model reloading, the service compiles and checks the new model, update() swaps it in
+  rclcpp::CallbackGroup::SharedPtr reload_callback_group_;
+  rclcpp::Service<mujoco_ros2_control_msgs::srv::ReloadModel>::SharedPtr reload_service_;
+  std::atomic<bool> reload_requested_;
+  std::mutex reload_mutex_;
+  std::condition_variable reload_cv_;
+  mjModel* reload_model_;
+  mjData* reload_data_;
+  std::unique_ptr<MujocoNameIndex> reload_name_index_;
+  std::function<void(mjModel*, mjData*)> reload_callback_;
+
+  std::unique_ptr<MujocoTracer> tracer_;
+  rclcpp::CallbackGroup::SharedPtr trace_callback_group_;
+  rclcpp::Service<mujoco_ros2_control_msgs::srv::DumpTrace>::SharedPtr trace_service_;
 };
 }  // namespace mujoco_ros2_control
 
@@ -0,0 +1,94 @@
+#ifndef MUJOCO_ROS2_CONTROL__MUJOCO_STATE_VALIDATOR_HPP_
+#define MUJOCO_ROS2_CONTROL__MUJOCO_STATE_VALIDATOR_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "mujoco_ros2_control_msgs/srv/check_state_validity.hpp"
+
+#include "mujoco/mujoco.h"
+
+#include "mujoco_ros2_control/live_state_handoff.hpp"
+
+namespace mujoco_ros2_control
+{
+// Checks batches of joint configurations for collisions against the simulated geometry, e.g. to
+// validate motion plans. States are evaluated with mj_kinematics and mj_collision on a pool of
+// worker threads, each with its own mjData, while the simulation keeps running on the live data.
+class MujocoStateValidator
+{
+public:
+  struct StateValidity
+  {
+    bool valid;
+    double penetration;  // depth of the deepest contact, 0 without penetration
+    int geom1;  // geoms of the deepest contact, -1 without penetration
+    int geom2;
+  };
+
+  MujocoStateValidator(
+    rclcpp::Node::SharedPtr & node, const mjModel* mujoco_model, const mjData* mujoco_data, size_t threads);
+  ~MujocoStateValidator();
+  // Callback group of the service, to be spun by an executor
+  rclcpp::CallbackGroup::SharedPtr get_callback_group() const;
+  // Called from the simulation thread after each step, copies the live state when requested
+  void update();
+  // Waits up to a second for the simulation thread to copy its live state, returns false on timeout.
+  // Must not be called from the simulation thread.
+  bool request_live_state();
+  // Checks positions.size() / joint_names.size() states against the last copied live state.
+  // Only hinge and slide joints can be set, returns false with an error otherwise.
+  bool check_states(
+    const std::vector<std::string> & joint_names, const std::vector<double> & positions,
+    double allowed_penetration, std::vector<StateValidity> & results, std::string & error);
+
+private:
+  void run_worker(size_t index);
+  void check_state(mjData* data, size_t state);
+  void service_callback(
+    const mujoco_ros2_control_msgs::srv::CheckStateValidity::Request::SharedPtr request,
+    mujoco_ros2_control_msgs::srv::CheckStateValidity::Response::SharedPtr response);
+
+  rclcpp::Logger logger_;
+  const mjModel* mj_model_;
+  const mjData* mj_data_;
+
+  // live state, copied by the simulation thread on request
+  LiveStateHandoff live_state_;
+  std::vector<mjtNum> live_qpos_;
+  std::vector<mjtNum> live_mocap_pos_;
+  std::vector<mjtNum> live_mocap_quat_;
+
+  // current batch, one at a time
+  std::mutex batch_mutex_;
+  std::vector<mjtNum> batch_qpos_;
+  std::vector<mjtNum> batch_mocap_pos_;
+  std::vector<mjtNum> batch_mocap_quat_;
+  std::vector<int> batch_qpos_adr_;
+  const double* batch_positions_;
+  double batch_allowed_penetration_;
+  StateValidity* batch_results_;
+  size_t batch_size_;
+  std::atomic<size_t> next_state_;
+
+  std::vector<mjData*> worker_data_;
+  std::vector<std::thread> workers_;
+  std::mutex worker_mutex_;
+  std::condition_variable worker_cv_;
+  std::condition_variable done_cv_;
+  size_t batch_generation_;
+  size_t finished_workers_;
+  bool stop_workers_;
+
+  std::vector<std::string> body_names_;
+  rclcpp::CallbackGroup::SharedPtr callback_group_;
+  rclcpp::Service<mujoco_ros2_control_msgs::srv::CheckStateValidity>::SharedPtr service_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__MUJOCO_STATE_VALIDATOR_HPP_
@@ -1,8 +1,11 @@
 #ifndef MUJOCO_ROS2_CONTROL__MUJOCO_SYSTEM_HPP_
 #define MUJOCO_ROS2_CONTROL__MUJOCO_SYSTEM_HPP_
 
+#include <array>
 #include <Eigen/Dense>
+#include "mujoco_ros2_control/actuator_dynamics.hpp"
 #include "mujoco_ros2_control/mujoco_system_interface.hpp"
+#include "mujoco_ros2_control/sensor_emulator.hpp"
 #include "hardware_interface/types/hardware_interface_type_values.hpp"
 #include "joint_limits/joint_limits.hpp"
 #include "control_toolbox/pid.hpp"
@@ -14,6 +17,7 @@ constexpr char PARAM_KI[] {"_ki"};
 constexpr char PARAM_KD[] {"_kd"};
 constexpr char PARAM_I_MAX[] {"_i_max"};
 constexpr char PARAM_I_MIN[] {"_i_min"};
+constexpr char PARAM_BIAS_FEEDFORWARD[] {"bias_feedforward"};
 
 class MujocoSystem : public MujocoSystemInterface
 {
@@ -22,11 +26,24 @@ public:
   std::vector<hardware_interface::StateInterface> export_state_interfaces() override;
   std::vector<hardware_interface::CommandInterface> export_command_interfaces() override;
 
+  hardware_interface::return_type prepare_command_mode_switch(
+    const std::vector<std::string> & start_interfaces,
+    const std::vector<std::string> & stop_interfaces) override;
+  hardware_interface::return_type perform_command_mode_switch(
+    const std::vector<std::string> & start_interfaces,
+    const std::vector<std::string> & stop_interfaces) override;
+
+  void latch_commands() override;
+
   hardware_interface::return_type read(const rclcpp::Time & time, const rclcpp::Duration & period) override;
   hardware_interface::return_type write(const rclcpp::Time & time, const rclcpp::Duration & period) override;
 
   bool init_sim(rclcpp::Node::SharedPtr & node, mjModel* mujoco_model, mjData *mujoco_data,
-    const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info) override;
+    const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info,
+    const MujocoNameIndex & name_index) override;
+  bool check_model(const mjModel* mujoco_model, const MujocoNameIndex & name_index, std::string & error) const override;
+  void reload_sim(mjModel* mujoco_model, mjData* mujoco_data, const MujocoNameIndex & name_index) override;
+  std::vector<EffortInput> get_effort_inputs() const override;
 
   struct JointState
   {
@@ -45,17 +62,66 @@ public:
     double max_effort_command;
     control_toolbox::Pid position_pid;
     control_toolbox::Pid velocity_pid;
+    // command interfaces declared in the URDF
+    bool has_position_command_interface {false};
+    bool has_velocity_command_interface {false};
+    bool has_effort_command_interface {false};
+    // command interfaces currently claimed by controllers
     bool is_position_control_enabled {false};
     bool is_velocity_control_enabled {false};
     bool is_effort_control_enabled {false};
     bool is_pid_enabled {false};
+    // add the bias forces (gravity, Coriolis, centrifugal) to the PID output
+    bool has_bias_feedforward {false};
+    // channels of the position, velocity and effort commands in actuator_dynamics_, -1 if none
+    std::array<int, 3> actuator_channels {-1, -1, -1};
     joint_limits::JointLimits joint_limits;
     bool is_mimic {false};
     int mimicked_joint_index;
     double mimic_multiplier;
-    int mj_joint_type;
-    int mj_pos_adr;
-    int mj_vel_adr;
+    int mj_joint_type {-1};
+    int mj_pos_adr {-1};
+    int mj_vel_adr {-1};
+    // full state and effort command of ball and free joints, in qpos/qvel order
+    std::array<double, 7> positions {};
+    std::array<double, 6> velocities {};
+    std::array<double, 6> efforts {};
+    std::array<double, 6> effort_commands {};
+    // last effort commands written to qfrc_applied, when unchanged commands are skipped
+    std::array<double, 6> applied_effort_commands {};
+  };
+
+  // Joint kernels process the joints listed in [begin, end) of an index list. They are specialized
+  // at compile time per joint type and control mode, see build_joint_kernels().
+  using JointKernel = void (*)(std::vector<JointState> & joint_states, const size_t* begin, const size_t* end,
+    mjData* mujoco_data, uint64_t period);
+
+  struct JointKernelRange
+  {
+    JointKernel kernel;
+    size_t begin;
+    size_t end;
+  };
+
+  // Interfaces declared in the URDF, resolved once in init_sim()
+  enum class InterfaceType : uint8_t
+  {
+    POSITION,
+    VELOCITY,
+    EFFORT,
+    POSITION_COMPONENT,  // ball and free joints
+    VELOCITY_COMPONENT,
+    EFFORT_COMPONENT,
+    FORCE,  // force torque sensors
+    TORQUE,
+    WRENCH,  // external wrench on a body
+  };
+
+  struct InterfaceDescriptor
+  {
+    uint32_t index;  // into joint_states_, ft_sensor_data_ or body_wrench_data_
+    InterfaceType type;
+    uint8_t component;
   };
 
   template <typename T>
@@ -73,6 +139,14 @@ public:
     SensorData<Eigen::Vector3d> torque;
   };
 
+  struct BodyWrenchData
+  {
+    std::string name;
+    int mj_body_id;
+    // force and torque at the center of mass, in the world frame
+    std::array<double, 6> commands {};
+  };
+
   struct IMUSensorData
   {
     std::string name;
@@ -82,22 +156,55 @@ public:
   };
 
 private:
-  void register_joints(const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info);
-  void register_sensors(const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info);
+  void register_joints(const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info,
+    const MujocoNameIndex & name_index);
+  void register_sensors(const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info,
+    const MujocoNameIndex & name_index);
+  void register_body_wrenches(const hardware_interface::HardwareInfo & hardware_info, const MujocoNameIndex & name_index);
   void set_initial_pose();
+  const std::string & get_interface_name(const InterfaceDescriptor & descriptor) const;
+  double* get_command_target(const InterfaceDescriptor & descriptor);
+  double* get_state_source(const InterfaceDescriptor & descriptor);
+  void register_sensor_models(const hardware_interface::HardwareInfo & hardware_info);
+  void register_actuator_models(const hardware_interface::HardwareInfo & hardware_info);
+  void apply_command_mode_switch(
+    const std::vector<std::string> & start_interfaces, const std::vector<std::string> & stop_interfaces);
+  void build_joint_kernels();
+  void reset_applied_commands();
   void get_joint_limits(urdf::JointConstSharedPtr urdf_joint, joint_limits::JointLimits& joint_limits);
   control_toolbox::Pid get_pid_gains(const hardware_interface::ComponentInfo& joint_info, std::string command_interface);
-  double clamp(double v, double lo, double hi)
-  {
-    return (v < lo) ? lo : (hi < v) ? hi : v;
-  }
 
   std::vector<JointState> joint_states_;
+  // indices into joint_states_ grouped by kernel, and the range of each kernel
+  std::vector<size_t> read_kernel_joints_;
+  std::vector<JointKernelRange> read_kernels_;
+  std::vector<size_t> write_kernel_joints_;
+  std::vector<JointKernelRange> write_kernels_;
+  std::vector<std::pair<JointKernel, size_t>> kernel_entries_;
+  // skip effort joints whose command did not change since the last write
+  bool skip_unchanged_commands_;
+  rclcpp::Time last_write_time_;
   std::vector<FTSensorData> ft_sensor_data_;
   std::vector<IMUSensorData> imu_sensor_data_;
+  std::vector<BodyWrenchData> body_wrench_data_;
+  // noise, bias and latency of the state interfaces, applied at the end of read()
+  SensorEmulator sensor_emulator_;
+  // saturation, delay, lag and rate limit of the scalar joint commands, applied at the start of write()
+  ActuatorDynamics actuator_dynamics_;
 
-  std::unordered_map<std::string, hardware_interface::ComponentInfo> joint_hw_info_;
-  std::unordered_map<std::string, hardware_interface::ComponentInfo> sensors_hw_info_;
+  std::vector<InterfaceDescriptor> state_interfaces_;
+  std::vector<InterfaceDescriptor> command_interfaces_;
+  // full command interface name, e.g. "joint1/position", to its descriptor
+  std::unordered_map<std::string, InterfaceDescriptor> command_interface_index_;
+  // body wrench command interfaces have no control mode, they are only cleared when released.
+  // Maps to the position in command_interfaces_.
+  std::unordered_map<std::string, size_t> body_wrench_interface_index_;
+  // written by controllers, copied to command_targets_ by latch_commands(), both indexed like command_interfaces_
+  std::vector<double> command_buffer_;
+  std::vector<double*> command_targets_;
+  std::vector<std::string> pending_start_interfaces_;
+  std::vector<std::string> pending_stop_interfaces_;
+  bool has_pending_switch_;
 
   mjModel* mj_model_;
   mjData* mj_data_;
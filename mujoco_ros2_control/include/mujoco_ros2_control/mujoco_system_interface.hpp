@@ -1,11 +1,16 @@
 #ifndef MUJOCO_ROS2_CONTROL__MUJOCO_SYSTEM_INTERFACE_HPP_
 #define MUJOCO_ROS2_CONTROL__MUJOCO_SYSTEM_INTERFACE_HPP_
 
+#include <string>
+#include <vector>
+
 #include "rclcpp/rclcpp.hpp"
 #include "hardware_interface/system_interface.hpp"
 #include "urdf/model.h"
 #include "mujoco/mujoco.h"
 
+#include "mujoco_ros2_control/mujoco_name_index.hpp"
+
 namespace mujoco_ros2_control
 {
 using CallbackReturn = rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn;
@@ -14,7 +19,37 @@ class MujocoSystemInterface : public hardware_interface::SystemInterface
 {
 public:
   virtual bool init_sim(rclcpp::Node::SharedPtr & node, mjModel* mujoco_model, mjData *mujoco_data,
-    const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info) = 0;
+    const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info,
+    const MujocoNameIndex & name_index) = 0;
+  // Applies the commands and command mode switches received since the last call. Called after
+  // every controller update, so that write() never reads commands while controllers set them.
+  virtual void latch_commands() = 0;
+  // Checks that a new model has everything the component uses, before it replaces the current
+  // one. Called from a background thread, so it must only read what init_sim() set up.
+  virtual bool check_model(const mjModel* /* mujoco_model */, const MujocoNameIndex & /* name_index */,
+    std::string & error) const
+  {
+    error = "The hardware component does not support reloading the model";
+    return false;
+  }
+  // Switches to a model which passed check_model(), keeping the exported interfaces. Called
+  // between two steps, while the previous model and data are still valid.
+  virtual void reload_sim(mjModel* /* mujoco_model */, mjData* /* mujoco_data */,
+    const MujocoNameIndex & /* name_index */)
+  {
+  }
+
+  // An effort command interface and the DOF of qfrc_applied it drives
+  struct EffortInput
+  {
+    std::string name;
+    int dof;
+  };
+  // Effort command interfaces, linearized next to the MuJoCo actuators
+  virtual std::vector<EffortInput> get_effort_inputs() const
+  {
+    return {};
+  }
 
 protected:
   rclcpp::Node::SharedPtr node_;  // TODO: need node?
@@ -0,0 +1,90 @@
+#ifndef MUJOCO_ROS2_CONTROL__MUJOCO_TRACER_HPP_
+#define MUJOCO_ROS2_CONTROL__MUJOCO_TRACER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mujoco_ros2_control
+{
+// Records how long the phases of the simulation loop take on each thread and writes them in the
+// Chrome trace event format. Every thread records into its own ring buffer, which only it writes
+// to, so recording takes no lock. The buffer of a thread is allocated by its first event, older
+// events are overwritten once it is full.
+class MujocoTracer
+{
+public:
+  explicit MujocoTracer(size_t events_per_thread);
+  MujocoTracer(const MujocoTracer &) = delete;
+  MujocoTracer & operator=(const MujocoTracer &) = delete;
+
+  // Names the calling thread in the trace and allocates its buffer up front
+  void set_thread_name(const std::string & name);
+  // Nanoseconds since the tracer was created
+  int64_t now() const;
+  // name must outlive the tracer, e.g. a string literal
+  void record(const char* name, int64_t start, int64_t end);
+  // Writes the events recorded so far, sorted by thread, returns how many or -1 on failure.
+  // May be called while other threads record.
+  long dump(const std::string & path) const;
+
+private:
+  // a slot may be read by dump() while its thread overwrites it, so the fields are atomic and
+  // dump() drops the slots whose content may be torn
+  struct Event
+  {
+    std::atomic<const char*> name {nullptr};
+    std::atomic<int64_t> start {0};
+    std::atomic<int64_t> duration {0};
+  };
+
+  struct Ring
+  {
+    std::string thread_name;
+    std::unique_ptr<Event[]> events;
+    size_t capacity;
+    // number of events recorded, the next one goes to count % capacity
+    std::atomic<uint64_t> count {0};
+  };
+
+  Ring* get_ring();
+
+  const uint64_t id_;
+  const size_t events_per_thread_;
+  const std::chrono::steady_clock::time_point start_;
+  mutable std::mutex rings_mutex_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+// Records the lifetime of the scope as one event, does nothing without a tracer
+class ScopedTrace
+{
+public:
+  ScopedTrace(MujocoTracer* tracer, const char* name)
+    : tracer_(tracer), name_(name), start_(tracer ? tracer->now() : 0)
+  {
+  }
+
+  ~ScopedTrace()
+  {
+    if (tracer_)
+    {
+      tracer_->record(name_, start_, tracer_->now());
+    }
+  }
+
+  ScopedTrace(const ScopedTrace &) = delete;
+  ScopedTrace & operator=(const ScopedTrace &) = delete;
+
+private:
+  MujocoTracer* tracer_;
+  const char* name_;
+  int64_t start_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__MUJOCO_TRACER_HPP_
@@ -0,0 +1,52 @@
+#ifndef MUJOCO_ROS2_CONTROL__MUJOCO_WRENCH_INJECTOR_HPP_
+#define MUJOCO_ROS2_CONTROL__MUJOCO_WRENCH_INJECTOR_HPP_
+
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "mujoco_ros2_control_msgs/msg/body_wrench.hpp"
+
+#include "mujoco/mujoco.h"
+
+#include "mujoco_ros2_control/spsc_queue.hpp"
+
+namespace mujoco_ros2_control
+{
+// Applies timed external wrenches received on ~/body_wrench to bodies through xfrc_applied.
+// Messages are handed from the executor thread to the simulation thread through a lock-free
+// queue, so the simulation loop never waits on the subscription.
+class MujocoWrenchInjector
+{
+public:
+  MujocoWrenchInjector(
+    rclcpp::Node::SharedPtr & node, const mjModel* mujoco_model, mjData* mujoco_data, size_t queue_size);
+  // Callback group of the subscription, to be spun by an executor
+  rclcpp::CallbackGroup::SharedPtr get_callback_group() const;
+  // Adds the wrenches acting during the next step to xfrc_applied
+  void update();
+
+private:
+  struct TimedWrench
+  {
+    int body_id;
+    mjtNum wrench[6];
+    double start;  // negative to start on reception
+    double duration;
+  };
+
+  void wrench_callback(const mujoco_ros2_control_msgs::msg::BodyWrench::SharedPtr msg);
+
+  rclcpp::Logger logger_;
+  const mjModel* mj_model_;
+  mjData* mj_data_;
+
+  SpscQueue<TimedWrench> queue_;
+  // pending and active wrenches, only touched by the simulation thread
+  std::vector<TimedWrench> wrenches_;
+
+  rclcpp::CallbackGroup::SharedPtr callback_group_;
+  rclcpp::Subscription<mujoco_ros2_control_msgs::msg::BodyWrench>::SharedPtr wrench_subscription_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__MUJOCO_WRENCH_INJECTOR_HPP_
@@ -0,0 +1,76 @@
+#ifndef MUJOCO_ROS2_CONTROL__SENSOR_EMULATOR_HPP_
+#define MUJOCO_ROS2_CONTROL__SENSOR_EMULATOR_HPP_
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mujoco_ros2_control
+{
+struct SensorModel
+{
+  double noise_stddev {0.0};  // white gaussian noise
+  double bias_drift {0.0};  // standard deviation of the bias random walk after one second
+  double quantization {0.0};  // resolution of the reading
+  double delay {0.0};  // fixed latency in seconds
+  double delay_jitter {0.0};  // additional latency, uniformly distributed in [0, delay_jitter]
+
+  bool is_enabled() const;
+  // Reads <prefix>_noise_stddev, <prefix>_bias_drift, ... from component parameters
+  static SensorModel from_parameters(
+    const std::unordered_map<std::string, std::string> & parameters, const std::string & prefix);
+};
+
+// Turns perfect readings into realistic ones: delays them through a ring buffer per channel, adds
+// a drifting bias and noise and quantizes the result. All storage is allocated by add() and
+// reset(), and the random numbers are drawn in a fixed order from a single seeded engine, so two
+// runs with the same seed and the same readings emulate the same sensors.
+class SensorEmulator
+{
+public:
+  SensorEmulator();
+  // The reading in *value is replaced by the emulated one on every apply(). sample_period is the
+  // shortest time between two applies, it sizes the delay line.
+  void add(double* value, const SensorModel & model, double sample_period);
+  bool empty() const;
+  // Clears the delay lines and biases and reseeds the engine
+  void reset(uint64_t seed);
+  void apply(double time, double period);
+
+private:
+  struct Channel
+  {
+    double* value;
+    SensorModel model;
+    double bias;
+    // delay line in samples_, oldest sample at head
+    size_t begin;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    double last_output_time;
+    double last_output;
+  };
+
+  struct Sample
+  {
+    double time;
+    double value;
+  };
+
+  double delay(Channel & channel, double time, double value, double jitter);
+
+  std::vector<Channel> channels_;
+  std::vector<Sample> samples_;
+  // random numbers of one apply, three per channel: noise, bias increment and jitter
+  std::vector<double> random_numbers_;
+  std::mt19937_64 engine_;
+  std::normal_distribution<double> normal_;
+  std::uniform_real_distribution<double> uniform_;
+  double last_time_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__SENSOR_EMULATOR_HPP_
@@ -0,0 +1,66 @@
+#ifndef MUJOCO_ROS2_CONTROL__SPSC_QUEUE_HPP_
+#define MUJOCO_ROS2_CONTROL__SPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace mujoco_ros2_control
+{
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// The storage is allocated once, push() and pop() never block nor allocate.
+template <typename T>
+class SpscQueue
+{
+public:
+  explicit SpscQueue(size_t capacity)
+    : buffer_(capacity + 1), head_(0), tail_(0)
+  {
+  }
+
+  // Producer side, returns false if the queue is full
+  bool push(const T & value)
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t next = increment(tail);
+    if (next == head_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    buffer_[tail] = value;
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, returns false if the queue is empty
+  bool pop(T & value)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    value = buffer_[head];
+    head_.store(increment(head), std::memory_order_release);
+    return true;
+  }
+
+  size_t capacity() const
+  {
+    return buffer_.size() - 1;
+  }
+
+private:
+  size_t increment(size_t index) const
+  {
+    return index + 1 == buffer_.size() ? 0 : index + 1;
+  }
+
+  std::vector<T> buffer_;
+  // head and tail are written by different threads, keep them on separate cache lines
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__SPSC_QUEUE_HPP_
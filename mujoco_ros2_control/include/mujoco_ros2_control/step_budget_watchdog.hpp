@@ -0,0 +1,81 @@
+#ifndef MUJOCO_ROS2_CONTROL__STEP_BUDGET_WATCHDOG_HPP_
+#define MUJOCO_ROS2_CONTROL__STEP_BUDGET_WATCHDOG_HPP_
+
+#include <chrono>
+
+#include "rclcpp/rclcpp.hpp"
+#include "diagnostic_msgs/msg/diagnostic_array.hpp"
+
+#include "mujoco/mujoco.h"
+
+#include "mujoco_ros2_control/mujoco_ros2_control.hpp"
+
+namespace mujoco_ros2_control
+{
+// Measures the wall time spent per simulation step and per rendered frame, publishes the
+// real-time factor and overruns on /diagnostics and, if enabled, trades rendering, /clock
+// rate and solver accuracy for speed while the simulation cannot keep up with real time.
+class StepBudgetWatchdog
+{
+public:
+  enum DegradationLevel
+  {
+    NOMINAL = 0,
+    SKIP_RENDERING = 1,
+    REDUCE_CLOCK = 2,
+    CHEAP_SOLVER = 3
+  };
+
+  StepBudgetWatchdog(
+    rclcpp::Node::SharedPtr & node, mjModel* mujoco_model, mjData* mujoco_data, MujocoRos2Control & control,
+    double frame_period);
+  void begin_step();
+  void end_step();
+  // Called once per frame of the main loop, returns whether the frame should be rendered.
+  // Skipped frames are paced to the frame period instead of the display's v-sync.
+  bool end_frame();
+  // Watches another model from now on, which is degraded like the previous one
+  void set_model(mjModel* mujoco_model, mjData* mujoco_data);
+
+private:
+  void end_window(std::chrono::steady_clock::time_point now);
+  void set_degradation_level(int level);
+  void apply_solver_degradation();
+  void publish_diagnostics(double real_time_factor, double load);
+
+  rclcpp::Logger logger_;
+  rclcpp::Clock::SharedPtr clock_;
+  mjModel* mj_model_;
+  mjData* mj_data_;
+  MujocoRos2Control & control_;
+
+  bool degrade_;
+  double min_real_time_factor_;
+  double report_period_;
+  double frame_period_;
+  int clock_decimation_;
+  int threads_;
+  int original_iterations_;
+  int original_ls_iterations_;
+  int level_;
+
+  std::chrono::steady_clock::time_point step_start_;
+  std::chrono::steady_clock::time_point frame_start_;
+  std::chrono::steady_clock::time_point window_start_;
+  double window_start_sim_time_;
+  double window_step_time_;
+  double window_max_step_time_;
+  long window_steps_;
+  long window_step_overruns_;
+  long window_frame_overruns_;
+  long window_skipped_frames_;
+  long total_step_overruns_;
+  long total_frame_overruns_;
+  long frame_count_;
+
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_publisher_;
+  diagnostic_msgs::msg::DiagnosticArray diagnostics_msg_;
+};
+}  // namespace mujoco_ros2_control
+
+#endif  // MUJOCO_ROS2_CONTROL__STEP_BUDGET_WATCHDOG_HPP_
@@ -0,0 +1,90 @@
+#include "mujoco_ros2_control/actuator_dynamics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mujoco_ros2_control
+{
+ActuatorModel ActuatorModel::from_parameters(
+  const std::unordered_map<std::string, std::string> & parameters, const std::string & prefix)
+{
+  auto get = [&parameters, &prefix](const std::string & name)
+  {
+    auto parameter = parameters.find(prefix + "_" + name);
+    return parameter != parameters.end() ? std::stod(parameter->second) : 0.0;
+  };
+
+  ActuatorModel model;
+  model.time_constant = get("time_constant");
+  model.rate_limit = get("rate_limit");
+  model.delay = get("delay");
+  return model;
+}
+
+size_t ActuatorDynamics::add(double* output, const ActuatorModel & model, double min, double max, double sample_period)
+{
+  size_t delay_steps = model.delay > 0.0 ? static_cast<size_t>(std::lround(model.delay / sample_period)) : 0;
+
+  inputs_.push_back(*output);
+  outputs_.push_back(output);
+  states_.push_back(*output);
+  lag_factors_.push_back(sample_period / (std::max(model.time_constant, 0.0) + sample_period));
+  max_changes_.push_back(model.rate_limit > 0.0 ? model.rate_limit * sample_period : std::numeric_limits<double>::infinity());
+  mins_.push_back(min);
+  maxs_.push_back(max);
+  line_begins_.push_back(line_samples_.size());
+  line_sizes_.push_back(delay_steps + 1);
+  line_heads_.push_back(0);
+  line_samples_.resize(line_samples_.size() + delay_steps + 1, *output);
+  return inputs_.size() - 1;
+}
+
+double* ActuatorDynamics::get_input(size_t channel)
+{
+  return &inputs_[channel];
+}
+
+void ActuatorDynamics::reset(size_t channel, double value)
+{
+  states_[channel] = value;
+  std::fill_n(line_samples_.begin() + line_begins_[channel], line_sizes_[channel], value);
+  line_heads_[channel] = 0;
+}
+
+void ActuatorDynamics::reset()
+{
+  for (size_t i = 0; i < inputs_.size(); i++)
+  {
+    reset(i, std::clamp(inputs_[i], mins_[i], maxs_[i]));
+  }
+}
+
+void ActuatorDynamics::apply()
+{
+  for (size_t i = 0; i < inputs_.size(); i++)
+  {
+    double command = std::clamp(inputs_[i], mins_[i], maxs_[i]);
+
+    // the line holds the commands of the last line_sizes_[i] steps, the newest one replaces the oldest
+    size_t head = line_heads_[i];
+    line_samples_[line_begins_[i] + head] = command;
+    head = head + 1 == line_sizes_[i] ? 0 : head + 1;
+    line_heads_[i] = head;
+    double delayed = line_samples_[line_begins_[i] + head];
+
+    // channels without lag and rate limit pass the command through unchanged, and a state which
+    // is not finite, e.g. after a NaN command, starts over from the command instead of staying so
+    if ((lag_factors_[i] == 1.0 && std::isinf(max_changes_[i])) || !std::isfinite(states_[i]))
+    {
+      states_[i] = delayed;
+    }
+    else
+    {
+      double change = lag_factors_[i] * (delayed - states_[i]);
+      states_[i] += std::clamp(change, -max_changes_[i], max_changes_[i]);
+    }
+    *outputs_[i] = states_[i];
+  }
+}
+}  // namespace mujoco_ros2_control
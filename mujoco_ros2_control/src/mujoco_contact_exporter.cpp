@@ -0,0 +1,148 @@
+#include "mujoco_ros2_control/mujoco_contact_exporter.hpp"
+
+namespace mujoco_ros2_control
+{
+MujocoContactExporter::MujocoContactExporter(
+  rclcpp::Node::SharedPtr & node, const mjModel* mujoco_model, const mjData* mujoco_data,
+  const MujocoNameIndex & name_index, double publish_rate)
+  : logger_(rclcpp::get_logger(node->get_name() + std::string(".contact_exporter"))),
+    mj_model_(mujoco_model), mj_data_(mujoco_data), filtered_(false),
+    body_selected_(mujoco_model->nbody, false), geom_selected_(mujoco_model->ngeom, false),
+    publish_period_(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1.0 / publish_rate))),
+    last_publish_time_(0, 0, RCL_ROS_TIME)
+{
+  auto bodies = node->get_parameter_or<std::vector<std::string>>("contact_bodies", {});
+  auto geoms = node->get_parameter_or<std::vector<std::string>>("contact_geoms", {});
+  auto body_pairs = node->get_parameter_or<std::vector<std::string>>("contact_body_pairs", {});
+
+  for (const auto& body : bodies)
+  {
+    int id = name_index.get_id(mjtObj::mjOBJ_BODY, body);
+    if (id == -1)
+    {
+      RCLCPP_WARN_STREAM(logger_, "Failed to find body in mujoco model, body name: " << body);
+      continue;
+    }
+    body_selected_.at(id) = true;
+  }
+  for (const auto& geom : geoms)
+  {
+    int id = name_index.get_id(mjtObj::mjOBJ_GEOM, geom);
+    if (id == -1)
+    {
+      RCLCPP_WARN_STREAM(logger_, "Failed to find geom in mujoco model, geom name: " << geom);
+      continue;
+    }
+    geom_selected_.at(id) = true;
+  }
+  // pairs are given as "body1:body2", in either order
+  for (const auto& pair : body_pairs)
+  {
+    auto separator = pair.find(':');
+    int id1 = separator == std::string::npos ? -1 : name_index.get_id(mjtObj::mjOBJ_BODY, pair.substr(0, separator));
+    int id2 = separator == std::string::npos ? -1 : name_index.get_id(mjtObj::mjOBJ_BODY, pair.substr(separator + 1));
+    if (id1 == -1 || id2 == -1)
+    {
+      RCLCPP_WARN_STREAM(logger_, "Failed to find body pair in mujoco model, pair: " << pair);
+      continue;
+    }
+    body_pairs_.emplace_back(id1, id2);
+  }
+  filtered_ = !bodies.empty() || !geoms.empty() || !body_pairs.empty();
+
+  for (int id = 0; id < mj_model_->nbody; id++)
+  {
+    const char* name = mj_id2name(mj_model_, mjtObj::mjOBJ_BODY, id);
+    body_names_.push_back(name ? name : "");
+  }
+  for (int id = 0; id < mj_model_->ngeom; id++)
+  {
+    const char* name = mj_id2name(mj_model_, mjtObj::mjOBJ_GEOM, id);
+    geom_names_.push_back(name ? name : "");
+  }
+
+  // sized for a typical scene up front, grows only if more contacts are ever selected
+  selected_contacts_.reserve(100);
+  contact_msg_.contacts.reserve(100);
+  contact_publisher_ = node->create_publisher<mujoco_ros2_control_msgs::msg::ContactArray>("~/contacts", 10);
+}
+
+void MujocoContactExporter::update(const rclcpp::Time & sim_time)
+{
+  if (sim_time - last_publish_time_ < publish_period_)
+  {
+    return;
+  }
+  last_publish_time_ = sim_time;
+
+  // select first, so the forces are only computed for the published contacts
+  selected_contacts_.clear();
+  for (int i = 0; i < mj_data_->ncon; i++)
+  {
+    const auto& contact = mj_data_->contact[i];
+    // flex contacts have no geoms and excluded contacts transmit no force
+    if (contact.geom[0] < 0 || contact.geom[1] < 0 || contact.efc_address < 0)
+    {
+      continue;
+    }
+    if (!filtered_ || is_selected(contact))
+    {
+      selected_contacts_.push_back(i);
+    }
+  }
+
+  contact_msg_.header.stamp = sim_time;
+  contact_msg_.contacts.resize(selected_contacts_.size());
+  mjtNum wrench[6];
+  mjtNum world_wrench[6];
+  for (size_t i = 0; i < selected_contacts_.size(); i++)
+  {
+    const auto& contact = mj_data_->contact[selected_contacts_[i]];
+    auto& contact_msg = contact_msg_.contacts[i];
+
+    contact_msg.geom1 = geom_names_[contact.geom[0]];
+    contact_msg.geom2 = geom_names_[contact.geom[1]];
+    contact_msg.body1 = body_names_[mj_model_->geom_bodyid[contact.geom[0]]];
+    contact_msg.body2 = body_names_[mj_model_->geom_bodyid[contact.geom[1]]];
+    contact_msg.position.x = contact.pos[0];
+    contact_msg.position.y = contact.pos[1];
+    contact_msg.position.z = contact.pos[2];
+    // the first row of the contact frame is the normal
+    contact_msg.normal.x = contact.frame[0];
+    contact_msg.normal.y = contact.frame[1];
+    contact_msg.normal.z = contact.frame[2];
+    contact_msg.depth = contact.dist;
+
+    // the wrench is computed in the contact frame, rotate it into the world frame
+    mj_contactForce(mj_model_, mj_data_, selected_contacts_[i], wrench);
+    mju_mulMatTVec(world_wrench, contact.frame, wrench, 3, 3);
+    mju_mulMatTVec(world_wrench + 3, contact.frame, wrench + 3, 3, 3);
+    contact_msg.wrench.force.x = world_wrench[0];
+    contact_msg.wrench.force.y = world_wrench[1];
+    contact_msg.wrench.force.z = world_wrench[2];
+    contact_msg.wrench.torque.x = world_wrench[3];
+    contact_msg.wrench.torque.y = world_wrench[4];
+    contact_msg.wrench.torque.z = world_wrench[5];
+  }
+
+  contact_publisher_->publish(contact_msg_);
+}
+
+bool MujocoContactExporter::is_selected(const mjContact & contact) const
+{
+  int body1 = mj_model_->geom_bodyid[contact.geom[0]];
+  int body2 = mj_model_->geom_bodyid[contact.geom[1]];
+  if (body_selected_[body1] || body_selected_[body2] || geom_selected_[contact.geom[0]] || geom_selected_[contact.geom[1]])
+  {
+    return true;
+  }
+  for (const auto& pair : body_pairs_)
+  {
+    if ((pair.first == body1 && pair.second == body2) || (pair.first == body2 && pair.second == body1))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace mujoco_ros2_control
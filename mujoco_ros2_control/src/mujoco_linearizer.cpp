@@ -0,0 +1,193 @@
+#include "mujoco_ros2_control/mujoco_linearizer.hpp"
+
+#include <algorithm>
+
+namespace mujoco_ros2_control
+{
+MujocoLinearizer::MujocoLinearizer(
+  rclcpp::Node::SharedPtr & node, const mjModel* mujoco_model, const mjData* mujoco_data,
+  const std::vector<MujocoSystemInterface::EffortInput> & effort_inputs)
+  : logger_(rclcpp::get_logger(node->get_name() + std::string(".linearizer"))),
+    mj_model_(mujoco_model), mj_data_(mujoco_data),
+    live_state_(mj_stateSize(mujoco_model, mjSTATE_INTEGRATION)), scratch_data_(mj_makeData(mujoco_model)),
+    scratch_state_(live_state_.size())
+{
+  for (int i = 0; i < mj_model_->nu; i++)
+  {
+    const char* name = mj_id2name(mj_model_, mjOBJ_ACTUATOR, i);
+    input_names_.push_back(name != nullptr ? name : "actuator_" + std::to_string(i));
+  }
+  for (const auto& effort_input : effort_inputs)
+  {
+    input_names_.push_back(effort_input.name);
+    effort_dofs_.push_back(effort_input.dof);
+  }
+  if (input_names_.empty())
+  {
+    RCLCPP_WARN_STREAM(logger_, "The model has no actuators and no effort command interfaces, B will be empty");
+  }
+
+  // constructed from the simulation thread, so the live state can be copied directly
+  mj_getState(mj_model_, mj_data_, live_state_.data(), mjSTATE_INTEGRATION);
+
+  // not added to the node's default executor, MujocoRos2Control spins it on its services executor
+  callback_group_ = node->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+  service_ = node->create_service<mujoco_ros2_control_msgs::srv::Linearize>(
+    "~/linearize",
+    [this](
+      const mujoco_ros2_control_msgs::srv::Linearize::Request::SharedPtr request,
+      mujoco_ros2_control_msgs::srv::Linearize::Response::SharedPtr response)
+    { service_callback(request, response); },
+    rmw_qos_profile_services_default, callback_group_);
+}
+
+MujocoLinearizer::~MujocoLinearizer()
+{
+  mj_deleteData(scratch_data_);
+}
+
+rclcpp::CallbackGroup::SharedPtr MujocoLinearizer::get_callback_group() const
+{
+  return callback_group_;
+}
+
+void MujocoLinearizer::update()
+{
+  live_state_handoff_.serve([this]() { mj_getState(mj_model_, mj_data_, live_state_.data(), mjSTATE_INTEGRATION); });
+}
+
+bool MujocoLinearizer::request_live_state()
+{
+  return live_state_handoff_.request();
+}
+
+const std::vector<std::string> & MujocoLinearizer::get_input_names() const
+{
+  return input_names_;
+}
+
+bool MujocoLinearizer::linearize(
+  const std::vector<double> & qpos, const std::vector<double> & qvel, const std::vector<double> & act,
+  const std::vector<double> & ctrl, double eps, bool centered, std::vector<mjtNum> & a, std::vector<mjtNum> & b,
+  std::string & error)
+{
+  if ((!qpos.empty() && qpos.size() != static_cast<size_t>(mj_model_->nq)) ||
+    (!qvel.empty() && qvel.size() != static_cast<size_t>(mj_model_->nv)) ||
+    (!act.empty() && act.size() != static_cast<size_t>(mj_model_->na)) ||
+    (!ctrl.empty() && ctrl.size() != static_cast<size_t>(mj_model_->nu)))
+  {
+    error = "The state must be empty or match the sizes of the model, nq " + std::to_string(mj_model_->nq) +
+      ", nv " + std::to_string(mj_model_->nv) + ", na " + std::to_string(mj_model_->na) + ", nu " +
+      std::to_string(mj_model_->nu);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> scratch_lock(scratch_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(live_state_handoff_.mutex());
+    mj_setState(mj_model_, scratch_data_, live_state_.data(), mjSTATE_INTEGRATION);
+  }
+  if (!qpos.empty())
+  {
+    mju_copy(scratch_data_->qpos, qpos.data(), mj_model_->nq);
+  }
+  if (!qvel.empty())
+  {
+    mju_copy(scratch_data_->qvel, qvel.data(), mj_model_->nv);
+  }
+  if (!act.empty())
+  {
+    mju_copy(scratch_data_->act, act.data(), mj_model_->na);
+  }
+  if (!ctrl.empty())
+  {
+    mju_copy(scratch_data_->ctrl, ctrl.data(), mj_model_->nu);
+  }
+
+  int nv = mj_model_->nv;
+  int nu = mj_model_->nu;
+  int nx = 2 * nv + mj_model_->na;
+  int ni = static_cast<int>(input_names_.size());
+  eps = eps > 0.0 ? eps : 1e-6;
+  std::vector<mjtNum> b_ctrl(nx * nu);
+  a.resize(nx * nx);
+  // the linearization point, from which the effort inputs are perturbed
+  mj_getState(mj_model_, scratch_data_, scratch_state_.data(), mjSTATE_INTEGRATION);
+  mjd_transitionFD(
+    mj_model_, scratch_data_, eps, centered, a.data(), nu > 0 ? b_ctrl.data() : nullptr, nullptr, nullptr);
+
+  // the actuator columns, followed by the columns of the effort inputs, either may be empty
+  b.assign(nx * ni, 0.0);
+  for (int row = 0; nu > 0 && row < nx; row++)
+  {
+    std::copy_n(b_ctrl.data() + row * nu, nu, b.data() + row * ni);
+  }
+  if (effort_dofs_.empty())
+  {
+    return true;
+  }
+
+  std::vector<mjtNum> qpos_minus(mj_model_->nq), qpos_plus(mj_model_->nq);
+  std::vector<mjtNum> next_minus(nx), next_plus(nx);
+  std::vector<mjtNum> dq(nv);
+  if (!centered)
+  {
+    step_perturbed(-1, 0.0, qpos_minus, next_minus);
+  }
+  for (size_t i = 0; i < effort_dofs_.size(); i++)
+  {
+    int dof = effort_dofs_[i];
+    step_perturbed(dof, eps, qpos_plus, next_plus);
+    if (centered)
+    {
+      step_perturbed(dof, -eps, qpos_minus, next_minus);
+    }
+    mjtNum h = centered ? 2 * eps : eps;
+
+    int column = nu + static_cast<int>(i);
+    mj_differentiatePos(mj_model_, dq.data(), h, qpos_minus.data(), qpos_plus.data());
+    for (int row = 0; row < nv; row++)
+    {
+      b[row * ni + column] = dq[row];
+    }
+    for (int row = nv; row < nx; row++)
+    {
+      b[row * ni + column] = (next_plus[row] - next_minus[row]) / h;
+    }
+  }
+  mj_setState(mj_model_, scratch_data_, scratch_state_.data(), mjSTATE_INTEGRATION);
+  return true;
+}
+
+void MujocoLinearizer::step_perturbed(int dof, mjtNum perturbation, std::vector<mjtNum> & qpos, std::vector<mjtNum> & next)
+{
+  mj_setState(mj_model_, scratch_data_, scratch_state_.data(), mjSTATE_INTEGRATION);
+  if (dof >= 0)
+  {
+    scratch_data_->qfrc_applied[dof] += perturbation;
+  }
+  mj_step(mj_model_, scratch_data_);
+
+  // next holds (unused, qvel, act), the position difference is taken in the tangent space
+  mju_copy(qpos.data(), scratch_data_->qpos, mj_model_->nq);
+  mju_copy(next.data() + mj_model_->nv, scratch_data_->qvel, mj_model_->nv);
+  mju_copy(next.data() + 2 * mj_model_->nv, scratch_data_->act, mj_model_->na);
+}
+
+void MujocoLinearizer::service_callback(
+  const mujoco_ros2_control_msgs::srv::Linearize::Request::SharedPtr request,
+  mujoco_ros2_control_msgs::srv::Linearize::Response::SharedPtr response)
+{
+  if (!request_live_state())
+  {
+    RCLCPP_WARN_STREAM(logger_, "The simulation did not provide its state in time, linearizing around the last one");
+  }
+
+  response->success = linearize(
+    request->qpos, request->qvel, request->act, request->ctrl, request->eps, request->centered,
+    response->a, response->b, response->message);
+  response->nx = 2 * mj_model_->nv + mj_model_->na;
+  response->nu = input_names_.size();
+  response->inputs = input_names_;
+}
+}  // namespace mujoco_ros2_control
@@ -0,0 +1,151 @@
+#include "mujoco_ros2_control/mujoco_model_options.hpp"
+
+#include <string>
+
+namespace mujoco_ros2_control
+{
+namespace
+{
+const char* SOLVER_NAMES[] = {"pgs", "cg", "newton"};
+
+template <typename T>
+void override_option(rclcpp::Node::SharedPtr & node, const std::string & name, T & option)
+{
+  if (node->has_parameter(name))
+  {
+    option = node->get_parameter(name).get_value<T>();
+  }
+}
+}  // namespace
+
+mjModel* load_model(const std::string & path, std::string & error)
+{
+  char load_error[1000] = "Could not load binary model";
+  mjModel* mujoco_model;
+  if (path.size() > 4 && path.compare(path.size() - 4, 4, ".mjb") == 0)
+  {
+    mujoco_model = mj_loadModel(path.c_str(), 0);
+  }
+  else
+  {
+    mujoco_model = mj_loadXML(path.c_str(), 0, load_error, sizeof(load_error));
+  }
+  if (!mujoco_model)
+  {
+    error = load_error;
+  }
+  return mujoco_model;
+}
+
+const char* get_solver_name(int solver)
+{
+  return solver >= 0 && solver < 3 ? SOLVER_NAMES[solver] : "unknown";
+}
+
+void apply_solver_options(rclcpp::Node::SharedPtr & node, mjModel* mujoco_model)
+{
+  auto logger = rclcpp::get_logger(node->get_name() + std::string(".model_options"));
+  auto & opt = mujoco_model->opt;
+
+  if (node->has_parameter("solver"))
+  {
+    auto solver = node->get_parameter("solver").as_string();
+    if (solver == "pgs")
+    {
+      opt.solver = mjtSolver::mjSOL_PGS;
+    }
+    else if (solver == "cg")
+    {
+      opt.solver = mjtSolver::mjSOL_CG;
+    }
+    else if (solver == "newton")
+    {
+      opt.solver = mjtSolver::mjSOL_NEWTON;
+    }
+    else
+    {
+      RCLCPP_WARN_STREAM(logger, "Unknown solver '" << solver << "', keeping the one of the model");
+    }
+  }
+
+  int64_t iterations = opt.iterations;
+  int64_t ls_iterations = opt.ls_iterations;
+  int64_t noslip_iterations = opt.noslip_iterations;
+  override_option(node, "solver_iterations", iterations);
+  override_option(node, "solver_tolerance", opt.tolerance);
+  override_option(node, "ls_iterations", ls_iterations);
+  override_option(node, "ls_tolerance", opt.ls_tolerance);
+  override_option(node, "noslip_iterations", noslip_iterations);
+  override_option(node, "noslip_tolerance", opt.noslip_tolerance);
+  opt.iterations = static_cast<int>(iterations);
+  opt.ls_iterations = static_cast<int>(ls_iterations);
+  opt.noslip_iterations = static_cast<int>(noslip_iterations);
+
+  if (node->has_parameter("island"))
+  {
+    if (node->get_parameter("island").as_bool())
+    {
+      opt.enableflags |= mjtEnableBit::mjENBL_ISLAND;
+    }
+    else
+    {
+      opt.enableflags &= ~mjtEnableBit::mjENBL_ISLAND;
+    }
+  }
+
+  RCLCPP_INFO_STREAM(
+    logger, "Solver options: solver " << get_solver_name(opt.solver) << ", iterations " << opt.iterations
+    << ", tolerance " << opt.tolerance << ", ls_iterations " << opt.ls_iterations << ", noslip_iterations "
+    << opt.noslip_iterations << ", island " << ((opt.enableflags & mjtEnableBit::mjENBL_ISLAND) ? "on" : "off"));
+}
+
+MujocoThreadPool::MujocoThreadPool(rclcpp::Node::SharedPtr & node, mjData* mujoco_data)
+  : size_(0)
+#if mjVERSION_HEADER >= 310
+  , thread_pool_(nullptr)
+#endif
+{
+  auto logger = rclcpp::get_logger(node->get_name() + std::string(".model_options"));
+  auto threads = node->get_parameter_or<int>("mujoco_threads", 0);
+  if (threads <= 0)
+  {
+    return;
+  }
+#if mjVERSION_HEADER >= 310
+  thread_pool_ = mju_threadPoolCreate(threads);
+  mju_bindThreadPool(mujoco_data, thread_pool_);
+  size_ = threads;
+  RCLCPP_INFO_STREAM(logger, "Mujoco thread pool with " << threads << " threads bound to the simulation");
+#else
+  (void)mujoco_data;
+  RCLCPP_WARN_STREAM(logger, "This MuJoCo version has no thread pool, ignoring mujoco_threads");
+#endif
+}
+
+MujocoThreadPool::~MujocoThreadPool()
+{
+#if mjVERSION_HEADER >= 310
+  if (thread_pool_)
+  {
+    mju_threadPoolDestroy(thread_pool_);
+  }
+#endif
+}
+
+size_t MujocoThreadPool::size() const
+{
+  return size_;
+}
+
+void MujocoThreadPool::bind(mjData* mujoco_data)
+{
+#if mjVERSION_HEADER >= 310
+  if (thread_pool_)
+  {
+    mju_bindThreadPool(mujoco_data, thread_pool_);
+  }
+#else
+  (void)mujoco_data;
+#endif
+}
+}  // namespace mujoco_ros2_control
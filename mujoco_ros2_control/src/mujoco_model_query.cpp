@@ -0,0 +1,203 @@
+#include "mujoco_ros2_control/mujoco_model_query.hpp"
+
+namespace mujoco_ros2_control
+{
+MujocoModelQuery::MujocoModelQuery(const mjModel* mujoco_model, const mjData* mujoco_data)
+  : mj_model_(mujoco_model), mj_data_(mujoco_data), tick_(0), time_(mujoco_data->time),
+    qpos_(mujoco_data->qpos, mujoco_data->qpos + mujoco_model->nq),
+    qvel_(mujoco_data->qvel, mujoco_data->qvel + mujoco_model->nv),
+    qacc_(mujoco_data->qacc, mujoco_data->qacc + mujoco_model->nv),
+    act_(mujoco_data->act, mujoco_data->act + mujoco_model->na),
+    mocap_pos_(mujoco_data->mocap_pos, mujoco_data->mocap_pos + 3 * mujoco_model->nmocap),
+    mocap_quat_(mujoco_data->mocap_quat, mujoco_data->mocap_quat + 4 * mujoco_model->nmocap)
+{
+}
+
+MujocoModelQuery::~MujocoModelQuery()
+{
+  for (auto& scratch : scratches_)
+  {
+    mj_deleteData(scratch->data);
+  }
+}
+
+void MujocoModelQuery::update()
+{
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  tick_++;
+  time_ = mj_data_->time;
+  mju_copy(qpos_.data(), mj_data_->qpos, mj_model_->nq);
+  mju_copy(qvel_.data(), mj_data_->qvel, mj_model_->nv);
+  mju_copy(qacc_.data(), mj_data_->qacc, mj_model_->nv);
+  mju_copy(act_.data(), mj_data_->act, mj_model_->na);
+  mju_copy(mocap_pos_.data(), mj_data_->mocap_pos, 3 * mj_model_->nmocap);
+  mju_copy(mocap_quat_.data(), mj_data_->mocap_quat, 4 * mj_model_->nmocap);
+}
+
+void MujocoModelQuery::rebind(const mjModel* mujoco_model, const mjData* mujoco_data)
+{
+  {
+    std::unique_lock<std::shared_mutex> model_lock(model_mutex_);
+    for (auto& scratch : scratches_)
+    {
+      mj_deleteData(scratch->data);
+    }
+    scratches_.clear();
+    free_scratches_.clear();
+
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    mj_model_ = mujoco_model;
+    mj_data_ = mujoco_data;
+    qpos_.resize(mj_model_->nq);
+    qvel_.resize(mj_model_->nv);
+    qacc_.resize(mj_model_->nv);
+    act_.resize(mj_model_->na);
+    mocap_pos_.resize(3 * mj_model_->nmocap);
+    mocap_quat_.resize(4 * mj_model_->nmocap);
+  }
+  update();
+}
+
+int MujocoModelQuery::get_body_id(const std::string & name) const
+{
+  std::shared_lock<std::shared_mutex> model_lock(model_mutex_);
+  return mj_name2id(mj_model_, mjtObj::mjOBJ_BODY, name.c_str());
+}
+
+int MujocoModelQuery::get_site_id(const std::string & name) const
+{
+  std::shared_lock<std::shared_mutex> model_lock(model_mutex_);
+  return mj_name2id(mj_model_, mjtObj::mjOBJ_SITE, name.c_str());
+}
+
+MujocoModelQuery::ScratchLease::ScratchLease(MujocoModelQuery & query, int stages)
+  : query_(query), model_lock_(query.model_mutex_)
+{
+  {
+    std::lock_guard<std::mutex> lock(query_.scratch_mutex_);
+    if (query_.free_scratches_.empty())
+    {
+      query_.scratches_.push_back(std::make_unique<Scratch>(Scratch{mj_makeData(query_.mj_model_), -1, 0}));
+      query_.free_scratches_.push_back(query_.scratches_.back().get());
+    }
+    scratch_ = query_.free_scratches_.back();
+    query_.free_scratches_.pop_back();
+  }
+
+  const mjModel* model = query_.mj_model_;
+  Scratch* scratch = scratch_;
+  mjData* data = scratch->data;
+
+  {
+    std::lock_guard<std::mutex> lock(query_.snapshot_mutex_);
+    if (scratch->tick != query_.tick_)
+    {
+      scratch->tick = query_.tick_;
+      scratch->stages = 0;
+      data->time = query_.time_;
+      mju_copy(data->qpos, query_.qpos_.data(), model->nq);
+      mju_copy(data->qvel, query_.qvel_.data(), model->nv);
+      mju_copy(data->qacc, query_.qacc_.data(), model->nv);
+      mju_copy(data->act, query_.act_.data(), model->na);
+      mju_copy(data->mocap_pos, query_.mocap_pos_.data(), 3 * model->nmocap);
+      mju_copy(data->mocap_quat, query_.mocap_quat_.data(), 4 * model->nmocap);
+    }
+  }
+
+  // mj_inverse runs the position and velocity stages itself
+  if ((stages & (POSITION | VELOCITY)) && !(scratch->stages & POSITION))
+  {
+    mj_kinematics(model, data);
+    mj_comPos(model, data);
+    scratch->stages |= POSITION;
+  }
+  if ((stages & VELOCITY) && !(scratch->stages & VELOCITY))
+  {
+    mj_comVel(model, data);
+    mj_rne(model, data, 0, data->qfrc_bias);
+    scratch->stages |= VELOCITY;
+  }
+  if ((stages & INVERSE) && !(scratch->stages & INVERSE))
+  {
+    mj_inverse(model, data);
+    scratch->stages |= POSITION | VELOCITY | INVERSE;
+  }
+}
+
+MujocoModelQuery::ScratchLease::~ScratchLease()
+{
+  std::lock_guard<std::mutex> lock(query_.scratch_mutex_);
+  query_.free_scratches_.push_back(scratch_);
+}
+
+MujocoModelQuery::Scratch & MujocoModelQuery::ScratchLease::get() const
+{
+  return *scratch_;
+}
+
+double MujocoModelQuery::get_time()
+{
+  ScratchLease scratch(*this, 0);
+  return scratch.get().data->time;
+}
+
+void MujocoModelQuery::get_body_pose(int body_id, mjtNum position[3], mjtNum quaternion[4])
+{
+  ScratchLease scratch(*this, POSITION);
+  const mjData* data = scratch.get().data;
+  mju_copy(position, data->xpos + 3 * body_id, 3);
+  mju_copy(quaternion, data->xquat + 4 * body_id, 4);
+}
+
+void MujocoModelQuery::get_site_pose(int site_id, mjtNum position[3], mjtNum rotation[9])
+{
+  ScratchLease scratch(*this, POSITION);
+  const mjData* data = scratch.get().data;
+  mju_copy(position, data->site_xpos + 3 * site_id, 3);
+  mju_copy(rotation, data->site_xmat + 9 * site_id, 9);
+}
+
+void MujocoModelQuery::get_site_jacobian(int site_id, std::vector<mjtNum> & jacp, std::vector<mjtNum> & jacr)
+{
+  ScratchLease scratch(*this, POSITION);
+  const mjData* data = scratch.get().data;
+  jacp.resize(3 * mj_model_->nv);
+  jacr.resize(3 * mj_model_->nv);
+  mj_jacSite(mj_model_, data, jacp.data(), jacr.data(), site_id);
+}
+
+void MujocoModelQuery::get_bias_forces(std::vector<mjtNum> & qfrc_bias)
+{
+  ScratchLease scratch(*this, VELOCITY);
+  const mjData* data = scratch.get().data;
+  qfrc_bias.assign(data->qfrc_bias, data->qfrc_bias + mj_model_->nv);
+}
+
+void MujocoModelQuery::get_inverse_dynamics(std::vector<mjtNum> & qfrc_inverse)
+{
+  ScratchLease scratch(*this, INVERSE);
+  const mjData* data = scratch.get().data;
+  qfrc_inverse.assign(data->qfrc_inverse, data->qfrc_inverse + mj_model_->nv);
+}
+
+bool MujocoModelQuery::get_inverse_dynamics(const std::vector<mjtNum> & qacc, std::vector<mjtNum> & qfrc_inverse)
+{
+  // checked under the lease, so that the model cannot be rebound in between
+  ScratchLease lease(*this, 0);
+  if (qacc.size() != static_cast<size_t>(mj_model_->nv))
+  {
+    return false;
+  }
+  auto& scratch = lease.get();
+  mjData* data = scratch.data;
+  // keep the accelerations of the last step for the cached query
+  std::vector<mjtNum> step_qacc(data->qacc, data->qacc + mj_model_->nv);
+  mju_copy(data->qacc, qacc.data(), mj_model_->nv);
+  mj_inverse(mj_model_, data);
+  qfrc_inverse.assign(data->qfrc_inverse, data->qfrc_inverse + mj_model_->nv);
+  mju_copy(data->qacc, step_qacc.data(), mj_model_->nv);
+  // the state dependent stages stay valid, only qfrc_inverse was overwritten
+  scratch.stages = (scratch.stages & ~INVERSE) | POSITION | VELOCITY;
+  return true;
+}
+}  // namespace mujoco_ros2_control
@@ -0,0 +1,42 @@
+#include "mujoco_ros2_control/mujoco_name_index.hpp"
+
+namespace mujoco_ros2_control
+{
+MujocoNameIndex::MujocoNameIndex(const mjModel* mujoco_model) : mj_model_(mujoco_model)
+{
+  add_objects(mjtObj::mjOBJ_BODY, mj_model_->nbody);
+  add_objects(mjtObj::mjOBJ_JOINT, mj_model_->njnt);
+  add_objects(mjtObj::mjOBJ_GEOM, mj_model_->ngeom);
+  add_objects(mjtObj::mjOBJ_SITE, mj_model_->nsite);
+  add_objects(mjtObj::mjOBJ_ACTUATOR, mj_model_->nu);
+  add_objects(mjtObj::mjOBJ_SENSOR, mj_model_->nsensor);
+}
+
+int MujocoNameIndex::get_id(mjtObj type, const std::string & name) const
+{
+  auto type_it = ids_.find(type);
+  if (type_it == ids_.end())
+  {
+    // not indexed
+    return mj_name2id(mj_model_, type, name.c_str());
+  }
+
+  auto it = type_it->second.find(name);
+  return it != type_it->second.end() ? it->second : -1;
+}
+
+void MujocoNameIndex::add_objects(mjtObj type, int count)
+{
+  auto& ids = ids_[type];
+  ids.reserve(count);
+  for (int id = 0; id < count; id++)
+  {
+    const char* name = mj_id2name(mj_model_, type, id);
+    if (name != nullptr)
+    {
+      // mj_name2id returns the first match, so keep the first id for duplicate names
+      ids.emplace(name, id);
+    }
+  }
+}
+}  // namespace mujoco_ros2_control
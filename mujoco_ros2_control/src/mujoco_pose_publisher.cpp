@@ -0,0 +1,143 @@
+#include "mujoco_ros2_control/mujoco_pose_publisher.hpp"
+
+namespace mujoco_ros2_control
+{
+namespace
+{
+std::string get_body_name(const mjModel* mujoco_model, int body_id)
+{
+  const char* name = mj_id2name(mujoco_model, mjtObj::mjOBJ_BODY, body_id);
+  return name ? name : "body_" + std::to_string(body_id);
+}
+}  // namespace
+
+MujocoPosePublisher::MujocoPosePublisher(
+  rclcpp::Node::SharedPtr & node, const mjModel* mujoco_model, const mjData* mujoco_data,
+  const MujocoNameIndex & name_index, double publish_rate)
+  : logger_(rclcpp::get_logger(node->get_name() + std::string(".pose_publisher"))),
+    mj_model_(mujoco_model), mj_data_(mujoco_data),
+    publish_period_(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1.0 / publish_rate))),
+    last_publish_time_(0, 0, RCL_ROS_TIME)
+{
+  auto tf_bodies = node->get_parameter_or<std::vector<std::string>>("tf_bodies", {});
+  auto odometry_bodies = node->get_parameter_or<std::vector<std::string>>("odometry_bodies", {});
+
+  // opt-in, so that the frames of robot_state_publisher are not published twice
+  std::vector<char> on_tf(mj_model_->nbody, false);
+  for (const auto& body : tf_bodies)
+  {
+    int id = name_index.get_id(mjtObj::mjOBJ_BODY, body);
+    if (id <= 0)
+    {
+      RCLCPP_WARN_STREAM(logger_, "Failed to find body in mujoco model, body name: " << body);
+      continue;
+    }
+    on_tf.at(id) = true;
+  }
+
+  // bodies come after their parents, so the transforms are listed from the root down
+  std::string world_frame = get_body_name(mj_model_, 0);
+  for (int id = 1; id < mj_model_->nbody; id++)
+  {
+    if (!on_tf[id])
+    {
+      continue;
+    }
+    int parent = mj_model_->body_parentid[id];
+    while (parent != 0 && !on_tf[parent])
+    {
+      parent = mj_model_->body_parentid[parent];
+    }
+    tf_bodies_.push_back(id);
+    tf_parents_.push_back(parent);
+
+    geometry_msgs::msg::TransformStamped transform;
+    transform.header.frame_id = get_body_name(mj_model_, parent);
+    transform.child_frame_id = get_body_name(mj_model_, id);
+    tf_msg_.transforms.push_back(transform);
+  }
+  if (!tf_bodies_.empty())
+  {
+    tf_publisher_ = node->create_publisher<tf2_msgs::msg::TFMessage>("/tf", rclcpp::QoS(100));
+  }
+
+  for (const auto& body : odometry_bodies)
+  {
+    int id = name_index.get_id(mjtObj::mjOBJ_BODY, body);
+    if (id <= 0)
+    {
+      RCLCPP_WARN_STREAM(logger_, "Failed to find body in mujoco model, body name: " << body);
+      continue;
+    }
+    OdometryBody odometry_body;
+    odometry_body.mj_body_id = id;
+    odometry_body.msg.header.frame_id = world_frame;
+    odometry_body.msg.child_frame_id = body;
+    odometry_body.publisher = node->create_publisher<nav_msgs::msg::Odometry>("~/odometry/" + body, 10);
+    odometry_bodies_.push_back(odometry_body);
+  }
+}
+
+void MujocoPosePublisher::update(const rclcpp::Time & sim_time)
+{
+  if (sim_time - last_publish_time_ < publish_period_)
+  {
+    return;
+  }
+  last_publish_time_ = sim_time;
+
+  mjtNum parent_inverse[4];
+  mjtNum offset[3];
+  mjtNum position[3];
+  mjtNum quaternion[4];
+  for (size_t i = 0; i < tf_bodies_.size(); i++)
+  {
+    int body = tf_bodies_[i];
+    int parent = tf_parents_[i];
+    // pose of the body in the frame of its parent on /tf
+    mju_negQuat(parent_inverse, mj_data_->xquat + 4 * parent);
+    mju_sub3(offset, mj_data_->xpos + 3 * body, mj_data_->xpos + 3 * parent);
+    mju_rotVecQuat(position, offset, parent_inverse);
+    mju_mulQuat(quaternion, parent_inverse, mj_data_->xquat + 4 * body);
+
+    auto& transform = tf_msg_.transforms[i];
+    transform.header.stamp = sim_time;
+    transform.transform.translation.x = position[0];
+    transform.transform.translation.y = position[1];
+    transform.transform.translation.z = position[2];
+    transform.transform.rotation.w = quaternion[0];
+    transform.transform.rotation.x = quaternion[1];
+    transform.transform.rotation.y = quaternion[2];
+    transform.transform.rotation.z = quaternion[3];
+  }
+  if (!tf_msg_.transforms.empty())
+  {
+    tf_publisher_->publish(tf_msg_);
+  }
+
+  mjtNum velocity[6];
+  for (auto& odometry_body : odometry_bodies_)
+  {
+    int body = odometry_body.mj_body_id;
+    auto& msg = odometry_body.msg;
+    msg.header.stamp = sim_time;
+    msg.pose.pose.position.x = mj_data_->xpos[3 * body];
+    msg.pose.pose.position.y = mj_data_->xpos[3 * body + 1];
+    msg.pose.pose.position.z = mj_data_->xpos[3 * body + 2];
+    msg.pose.pose.orientation.w = mj_data_->xquat[4 * body];
+    msg.pose.pose.orientation.x = mj_data_->xquat[4 * body + 1];
+    msg.pose.pose.orientation.y = mj_data_->xquat[4 * body + 2];
+    msg.pose.pose.orientation.z = mj_data_->xquat[4 * body + 3];
+
+    // the twist of odometry is expressed in the body frame, rotational part first in MuJoCo
+    mj_objectVelocity(mj_model_, mj_data_, mjtObj::mjOBJ_XBODY, body, velocity, 1);
+    msg.twist.twist.angular.x = velocity[0];
+    msg.twist.twist.angular.y = velocity[1];
+    msg.twist.twist.angular.z = velocity[2];
+    msg.twist.twist.linear.x = velocity[3];
+    msg.twist.twist.linear.y = velocity[4];
+    msg.twist.twist.linear.z = velocity[5];
+    odometry_body.publisher->publish(msg);
+  }
+}
+}  // namespace mujoco_ros2_control
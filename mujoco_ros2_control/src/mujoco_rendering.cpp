@@ -56,6 +56,18 @@ void MujocoRendering::init(rclcpp::Node::SharedPtr & node, mjModel* mujoco_model
   glfwSetScrollCallback(window_, &MujocoRendering::scroll_callback);
 }
 
+void MujocoRendering::reload(mjModel* mujoco_model, mjData* mujoco_data)
+{
+  mj_model_ = mujoco_model;
+  mj_data_ = mujoco_data;
+
+  // the scene and the context hold the meshes, textures and sizes of the model
+  mjv_freeScene(&mjv_scn_);
+  mjr_freeContext(&mjr_con_);
+  mjv_makeScene(mj_model_, &mjv_scn_, 2000);
+  mjr_makeContext(mj_model_, &mjr_con_, mjFONTSCALE_150);
+}
+
 bool MujocoRendering::is_close_flag_raised()
 {
   return glfwWindowShouldClose(window_);
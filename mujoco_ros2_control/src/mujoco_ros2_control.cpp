@@ -1,32 +1,182 @@
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
 #include "hardware_interface/system_interface.hpp"
 #include "hardware_interface/component_parser.hpp"
 #include "hardware_interface/resource_manager.hpp"
 
 #include "mujoco_ros2_control/mujoco_ros2_control.hpp"
+#include "mujoco_ros2_control/mujoco_model_options.hpp"
+
+// the events executor is only shipped with rclcpp from Iron on
+#if __has_include("rclcpp/experimental/executors/events_executor/events_executor.hpp")
+#include "rclcpp/experimental/executors/events_executor/events_executor.hpp"
+#define MUJOCO_ROS2_CONTROL_HAS_EVENTS_EXECUTOR
+#endif
 
 namespace mujoco_ros2_control
 {
+namespace
+{
+// Single-threaded executor recording every callback it runs in the trace, named by its kind
+class TracedExecutor : public rclcpp::executors::SingleThreadedExecutor
+{
+public:
+  explicit TracedExecutor(MujocoTracer* tracer)
+    : tracer_(tracer)
+  {
+  }
+
+  // the loop of SingleThreadedExecutor::spin(), with the execution of each callback traced
+  void spin() override
+  {
+    if (spinning.exchange(true))
+    {
+      throw std::runtime_error("spin() called while already spinning");
+    }
+    while (rclcpp::ok(context_) && spinning.load())
+    {
+      rclcpp::AnyExecutable any_executable;
+      if (get_next_executable(any_executable))
+      {
+        ScopedTrace trace(tracer_, get_name(any_executable));
+        execute_any_executable(any_executable);
+      }
+    }
+    spinning.store(false);
+  }
+
+private:
+  static const char* get_name(const rclcpp::AnyExecutable & any_executable)
+  {
+    if (any_executable.timer)
+    {
+      return "timer";
+    }
+    if (any_executable.subscription)
+    {
+      return "subscription";
+    }
+    if (any_executable.service)
+    {
+      return "service";
+    }
+    if (any_executable.client)
+    {
+      return "client";
+    }
+    return "waitable";
+  }
+
+  MujocoTracer* tracer_;
+};
+}  // namespace
+
 MujocoRos2Control::MujocoRos2Control(rclcpp::Node::SharedPtr & node, mjModel* mujoco_model, mjData* mujoco_data)
   : node_(node), mj_model_(mujoco_model), mj_data_(mujoco_data), logger_(rclcpp::get_logger(node_->get_name() + std::string(".mujoco_ros2_control"))),
-    control_period_(rclcpp::Duration(1, 0)), last_update_sim_time_ros_(0, 0, RCL_ROS_TIME)
+    cm_thread_priority_(0), cm_thread_cpu_(-1), control_period_(rclcpp::Duration(1, 0)), last_update_sim_time_ros_(0, 0, RCL_ROS_TIME),
+    publish_clock_(true), clock_decimation_(1), clock_counter_(0), pipelined_control_(false),
+    control_update_pending_(false), stop_control_thread_(false), control_update_time_(0, 0, RCL_ROS_TIME),
+    control_update_period_(0, 0), reload_requested_(false), reload_model_(nullptr), reload_data_(nullptr)
 {
 }
 
 MujocoRos2Control::~MujocoRos2Control()
 {
-  stop_cm_thread_ = true;
-  cm_executor_->remove_node(controller_manager_);
-  cm_executor_->cancel();
-  cm_thread_.join();
+  if (control_thread_.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(control_mutex_);
+      stop_control_thread_ = true;
+    }
+    control_cv_.notify_all();
+    control_thread_.join();
+  }
+
+  if (services_executor_)
+  {
+    services_executor_->cancel();
+    if (services_thread_.joinable())
+    {
+      services_thread_.join();
+    }
+    for (const auto& callback_group : get_callback_groups())
+    {
+      services_executor_->remove_callback_group(callback_group);
+    }
+    if (reload_callback_group_)
+    {
+      services_executor_->remove_callback_group(reload_callback_group_);
+    }
+    if (trace_callback_group_)
+    {
+      services_executor_->remove_callback_group(trace_callback_group_);
+    }
+  }
+
+  if (cm_executor_)
+  {
+    // cancel() wakes the executor up from its wait set, so spin() returns immediately
+    cm_executor_->cancel();
+    if (cm_thread_.joinable())
+    {
+      cm_thread_.join();
+    }
+    cm_executor_->remove_node(controller_manager_);
+  }
+
+  // a reload which timed out while the executor was stopping
+  if (reload_model_)
+  {
+    mj_deleteData(reload_data_);
+    mj_deleteModel(reload_model_);
+  }
 }
 
-void MujocoRos2Control::init()
+bool MujocoRos2Control::init()
 {
-  clock_publisher_ = node_->create_publisher<rosgraph_msgs::msg::Clock>("/clock", 10);
+  // created first, so that the threads configured from here on are named in the trace
+  auto trace_buffer_size = node_->get_parameter_or<int>("trace_buffer_size", 0);
+  if (trace_buffer_size > 0)
+  {
+    tracer_ = std::make_unique<MujocoTracer>(trace_buffer_size);
+  }
+
+  configure_realtime();
+
+  publish_clock_ = node_->get_parameter_or<bool>("publish_clock", true);
+  if (publish_clock_)
+  {
+    clock_publisher_ = node_->create_publisher<rosgraph_msgs::msg::Clock>("/clock", 10);
+  }
+  // Log how long each startup phase takes
+  auto phase_start = std::chrono::steady_clock::now();
+  auto log_phase = [this, &phase_start](const std::string & phase)
+    {
+      auto now = std::chrono::steady_clock::now();
+      double elapsed_ms = std::chrono::duration<double, std::milli>(now - phase_start).count();
+      RCLCPP_INFO_STREAM(logger_, "Startup phase '" << phase << "' took " << elapsed_ms << " ms");
+      phase_start = now;
+    };
+
   // Read urdf from ros parameter server then
   // setup actuators and mechanism control node.
   std::string urdf_string;
   std::vector<hardware_interface::HardwareInfo> control_hardware_info;
+  // The robot description is parsed once and shared by all hardware components
+  urdf::Model urdf_model;
   try
   {
     urdf_string = node_->get_parameter("robot_description").as_string();
@@ -35,8 +185,14 @@ void MujocoRos2Control::init()
   catch (const std::runtime_error & ex)
   {
     RCLCPP_ERROR_STREAM(logger_, "Error parsing URDF : " << ex.what());
-    return;
+    return false;
+  }
+  if (!urdf_model.initString(urdf_string))
+  {
+    RCLCPP_ERROR(logger_, "Error parsing URDF model");
+    return false;
   }
+  log_phase("parse robot description");
 
   try
   {
@@ -48,7 +204,7 @@ void MujocoRos2Control::init()
   catch (pluginlib::LibraryLoadException & ex)
   {
     RCLCPP_ERROR_STREAM(logger_, "Failed to create hardware interface loader:  " << ex.what());
-    return;
+    return false;
   }
 
   std::unique_ptr<hardware_interface::ResourceManager> resource_manager =
@@ -63,6 +219,8 @@ void MujocoRos2Control::init()
     RCLCPP_ERROR(logger_, "Error while initializing URDF!");
   }
 
+  std::vector<std::unique_ptr<MujocoSystemInterface>> mujoco_systems;
+  std::vector<const hardware_interface::HardwareInfo*> mujoco_systems_info;
   for (const auto& hardware : control_hardware_info)
   {
     std::string robot_hw_sim_type_str_ = hardware.hardware_class_type;
@@ -78,34 +236,108 @@ void MujocoRos2Control::init()
       continue;
     }
 
-    urdf::Model urdf_model;
-    urdf_model.initString(urdf_string);
-    if (!mujoco_system->init_sim(node_, mj_model_, mj_data_, urdf_model, hardware))
-    {
-      RCLCPP_FATAL(logger_, "Could not initialize robot simulation interface");
-      return;
-    }
+    mujoco_systems.push_back(std::move(mujoco_system));
+    mujoco_systems_info.push_back(&hardware);
+  }
+  log_phase("load hardware plugins");
+
+  // One name index for all components, instead of linear name lookups in each of them
+  MujocoNameIndex name_index(mj_model_);
+  log_phase("index model names");
 
-    resource_manager->import_component(std::move(mujoco_system), hardware);
+  // Components own disjoint joints and sensors, so they can be initialized concurrently
+  std::vector<std::future<bool>> init_results;
+  for (size_t i = 0; i < mujoco_systems.size(); i++)
+  {
+    init_results.push_back(std::async(std::launch::async,
+      [this, &mujoco_systems, &mujoco_systems_info, &urdf_model, &name_index, i]()
+      {
+        return mujoco_systems[i]->init_sim(node_, mj_model_, mj_data_, urdf_model, *mujoco_systems_info[i], name_index);
+      }));
+  }
+
+  bool is_initialized = true;
+  for (auto& result : init_results)
+  {
+    is_initialized &= result.get();
+  }
+  if (!is_initialized)
+  {
+    RCLCPP_FATAL(logger_, "Could not initialize robot simulation interface");
+    return false;
+  }
+  log_phase("initialize hardware components");
+
+  for (size_t i = 0; i < mujoco_systems.size(); i++)
+  {
+    const auto& hardware = *mujoco_systems_info[i];
+    // the resource manager takes ownership, commands are still latched through these pointers
+    mujoco_systems_.push_back(mujoco_systems[i].get());
+    resource_manager->import_component(std::move(mujoco_systems[i]), hardware);
 
     rclcpp_lifecycle::State state(
       lifecycle_msgs::msg::State::PRIMARY_STATE_ACTIVE,
       hardware_interface::lifecycle_state_names::ACTIVE);
     resource_manager->set_component_state(hardware.name, state);
   }
+  log_phase("activate hardware components");
+
+  settle();
+  log_phase("settle");
+
+  // after the hardware components, whose effort inputs are linearized, and from the settled state
+  create_components(name_index);
 
   // Create the controller manager
   RCLCPP_INFO(logger_, "Loading controller_manager");
-  cm_executor_ = std::make_shared<rclcpp::executors::MultiThreadedExecutor>();
+  cm_executor_ = create_executor();
+  if (!cm_executor_)
+  {
+    return false;
+  }
   controller_manager_ = std::make_shared<controller_manager::ControllerManager>(
       std::move(resource_manager), cm_executor_,
       "controller_manager", node_->get_namespace());
 
   cm_executor_->add_node(controller_manager_);
 
+  // two threads, so that one long running call does not hold up all other services
+  services_executor_ = std::make_shared<rclcpp::executors::MultiThreadedExecutor>(rclcpp::ExecutorOptions(), 2);
+  for (const auto& callback_group : get_callback_groups())
+  {
+    services_executor_->add_callback_group(callback_group, node_->get_node_base_interface());
+  }
+
+  if (node_->get_parameter_or<bool>("model_reload", false))
+  {
+    // compiling a model takes a while, so reloads do not share a callback group with the other services
+    reload_callback_group_ = node_->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+    reload_service_ = node_->create_service<mujoco_ros2_control_msgs::srv::ReloadModel>(
+      "~/reload_model",
+      [this](
+        const mujoco_ros2_control_msgs::srv::ReloadModel::Request::SharedPtr request,
+        mujoco_ros2_control_msgs::srv::ReloadModel::Response::SharedPtr response)
+      { reload_model_callback(request, response); },
+      rmw_qos_profile_services_default, reload_callback_group_);
+    services_executor_->add_callback_group(reload_callback_group_, node_->get_node_base_interface());
+  }
+
+  if (tracer_)
+  {
+    trace_callback_group_ = node_->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+    trace_service_ = node_->create_service<mujoco_ros2_control_msgs::srv::DumpTrace>(
+      "~/dump_trace",
+      [this](
+        const mujoco_ros2_control_msgs::srv::DumpTrace::Request::SharedPtr request,
+        mujoco_ros2_control_msgs::srv::DumpTrace::Response::SharedPtr response)
+      { dump_trace_callback(request, response); },
+      rmw_qos_profile_services_default, trace_callback_group_);
+    services_executor_->add_callback_group(trace_callback_group_, node_->get_node_base_interface());
+  }
+
   if (!controller_manager_->has_parameter("update_rate")) {
     RCLCPP_ERROR_STREAM(logger_, "controller manager doesn't have an update_rate parameter");
-    return;
+    return false;
   }
 
   auto update_rate = controller_manager_->get_parameter("update_rate").as_int();
@@ -116,45 +348,736 @@ void MujocoRos2Control::init()
   // Force setting of use_sime_time parameter
   controller_manager_->set_parameter(rclcpp::Parameter("use_sim_time", rclcpp::ParameterValue(true)));
 
-  stop_cm_thread_ = false;
   auto spin = [this]()
     {
-      while (rclcpp::ok() && !stop_cm_thread_) {
-        cm_executor_->spin_once();
-      }
+      configure_thread("controller_manager", cm_thread_priority_, cm_thread_cpu_);
+      // blocks until the executor is cancelled or the context is shut down
+      cm_executor_->spin();
     };
   cm_thread_ = std::thread(spin);
+  services_thread_ = std::thread([this]()
+    {
+      configure_thread("services", 0, -1);
+      services_executor_->spin();
+    });
+
+  pipelined_control_ = node_->get_parameter_or<bool>("pipelined_control", false);
+  if (pipelined_control_)
+  {
+    control_thread_ = std::thread([this]() { run_control_thread(); });
+  }
+
+  // init() is called from the thread running the simulation loop, it is configured last so that
+  // none of the threads spawned above inherits its affinity and priority
+  configure_thread("simulation", sim_thread_priority_, sim_thread_cpu_);
+  log_phase("start controller manager");
+  return true;
+}
+
+void MujocoRos2Control::create_components(const MujocoNameIndex & name_index)
+{
+  auto contact_publish_rate = node_->get_parameter_or<double>("contact_publish_rate", 0.0);
+  if (contact_publish_rate > 0.0)
+  {
+    contact_exporter_ = std::make_unique<MujocoContactExporter>(node_, mj_model_, mj_data_, name_index, contact_publish_rate);
+  }
+
+  auto pose_publish_rate = node_->get_parameter_or<double>("pose_publish_rate", 0.0);
+  if (pose_publish_rate > 0.0)
+  {
+    pose_publisher_ = std::make_unique<MujocoPosePublisher>(node_, mj_model_, mj_data_, name_index, pose_publish_rate);
+  }
+
+  if (node_->get_parameter_or<bool>("wrench_injection", false))
+  {
+    auto queue_size = node_->get_parameter_or<int>("wrench_queue_size", 1024);
+    wrench_injector_ = std::make_unique<MujocoWrenchInjector>(node_, mj_model_, mj_data_, std::max(1, queue_size));
+  }
+
+  auto state_validity_threads = node_->get_parameter_or<int>("state_validity_threads", 0);
+  if (state_validity_threads > 0)
+  {
+    state_validator_ = std::make_unique<MujocoStateValidator>(node_, mj_model_, mj_data_, state_validity_threads);
+  }
+
+  if (model_query_)
+  {
+    // kept across model reloads, since in-process tools hold on to it
+    model_query_->rebind(mj_model_, mj_data_);
+  }
+  else if (node_->get_parameter_or<bool>("model_queries", false))
+  {
+    model_query_ = std::make_unique<MujocoModelQuery>(mj_model_, mj_data_);
+  }
+
+  if (node_->get_parameter_or<bool>("linearization", false))
+  {
+    std::vector<MujocoSystemInterface::EffortInput> effort_inputs;
+    for (const auto& mujoco_system : mujoco_systems_)
+    {
+      auto system_inputs = mujoco_system->get_effort_inputs();
+      effort_inputs.insert(effort_inputs.end(), system_inputs.begin(), system_inputs.end());
+    }
+    linearizer_ = std::make_unique<MujocoLinearizer>(node_, mj_model_, mj_data_, effort_inputs);
+  }
+}
+
+std::vector<rclcpp::CallbackGroup::SharedPtr> MujocoRos2Control::get_callback_groups() const
+{
+  std::vector<rclcpp::CallbackGroup::SharedPtr> callback_groups;
+  if (wrench_injector_)
+  {
+    callback_groups.push_back(wrench_injector_->get_callback_group());
+  }
+  if (state_validator_)
+  {
+    callback_groups.push_back(state_validator_->get_callback_group());
+  }
+  if (linearizer_)
+  {
+    callback_groups.push_back(linearizer_->get_callback_group());
+  }
+  return callback_groups;
+}
+
+void MujocoRos2Control::reload_model_callback(
+  const mujoco_ros2_control_msgs::srv::ReloadModel::Request::SharedPtr request,
+  mujoco_ros2_control_msgs::srv::ReloadModel::Response::SharedPtr response)
+{
+  auto path = request->model_path.empty() ?
+    node_->get_parameter_or<std::string>("mujoco_model_path", "") : request->model_path;
+
+  // everything but the swap happens here, next to the running simulation
+  auto load_start = std::chrono::steady_clock::now();
+  std::string error;
+  mjModel* mujoco_model = load_model(path, error);
+  if (!mujoco_model)
+  {
+    response->success = false;
+    response->message = "Load model error: " + error;
+    return;
+  }
+  apply_solver_options(node_, mujoco_model);
+
+  auto name_index = std::make_unique<MujocoNameIndex>(mujoco_model);
+  for (auto mujoco_system : mujoco_systems_)
+  {
+    if (!mujoco_system->check_model(mujoco_model, *name_index, error))
+    {
+      mj_deleteModel(mujoco_model);
+      response->success = false;
+      response->message = error;
+      return;
+    }
+  }
+  mjData* mujoco_data = mj_makeData(mujoco_model);
+
+  std::unique_lock<std::mutex> lock(reload_mutex_);
+  reload_model_ = mujoco_model;
+  reload_data_ = mujoco_data;
+  reload_name_index_ = std::move(name_index);
+  reload_requested_.store(true, std::memory_order_release);
+  if (!reload_cv_.wait_for(lock, std::chrono::seconds(5),
+    [this]() { return !reload_requested_.load(std::memory_order_acquire); }))
+  {
+    reload_requested_.store(false, std::memory_order_release);
+    mj_deleteData(reload_data_);
+    mj_deleteModel(reload_model_);
+    reload_model_ = nullptr;
+    reload_data_ = nullptr;
+    reload_name_index_.reset();
+    response->success = false;
+    response->message = "The simulation did not reach the end of a step in time";
+    return;
+  }
+
+  double reload_time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+  response->success = true;
+  response->message = "Reloaded " + path + " in " + std::to_string(reload_time_ms) + " ms";
+  RCLCPP_INFO_STREAM(logger_, response->message);
+}
+
+void MujocoRos2Control::apply_model_reload()
+{
+  std::unique_lock<std::mutex> lock(reload_mutex_);
+  // the request may have timed out in the meantime
+  if (!reload_requested_.load(std::memory_order_acquire))
+  {
+    return;
+  }
+
+  // Service calls of the components may still be running on the previous model. Their callback
+  // groups are mutually exclusive, so they are idle once they can be taken from again. Calls
+  // waiting for the live state are served meanwhile, since they wait for this thread.
+  auto callback_groups = get_callback_groups();
+  for (const auto& callback_group : callback_groups)
+  {
+    services_executor_->remove_callback_group(callback_group);
+  }
+  while (!std::all_of(callback_groups.begin(), callback_groups.end(),
+    [](const rclcpp::CallbackGroup::SharedPtr & callback_group) { return callback_group->can_be_taken_from().load(); }))
+  {
+    if (state_validator_)
+    {
+      state_validator_->update();
+    }
+    if (linearizer_)
+    {
+      linearizer_->update();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // the hardware components carry the state of their joints over, the time goes on
+  reload_data_->time = mj_data_->time;
+  for (auto mujoco_system : mujoco_systems_)
+  {
+    mujoco_system->reload_sim(reload_model_, reload_data_, *reload_name_index_);
+  }
+  mj_forward(reload_model_, reload_data_);
+
+  // the components are created again for the new model, the previous ones go first so that
+  // their publishers and services are gone before the new ones are created
+  contact_exporter_.reset();
+  pose_publisher_.reset();
+  wrench_injector_.reset();
+  state_validator_.reset();
+  linearizer_.reset();
+
+  mjModel* previous_model = mj_model_;
+  mjData* previous_data = mj_data_;
+  mj_model_ = reload_model_;
+  mj_data_ = reload_data_;
+  // the components may spawn threads, which must not inherit the settings of the simulation thread
+  configure_thread("simulation", 0, -1);
+  create_components(*reload_name_index_);
+  configure_thread("simulation", sim_thread_priority_, sim_thread_cpu_);
+  for (const auto& callback_group : get_callback_groups())
+  {
+    services_executor_->add_callback_group(callback_group, node_->get_node_base_interface());
+  }
+
+  if (reload_callback_)
+  {
+    reload_callback_(mj_model_, mj_data_);
+  }
+  mj_deleteData(previous_data);
+  mj_deleteModel(previous_model);
+
+  reload_model_ = nullptr;
+  reload_data_ = nullptr;
+  reload_name_index_.reset();
+  reload_requested_.store(false, std::memory_order_release);
+  lock.unlock();
+  reload_cv_.notify_all();
+}
+
+void MujocoRos2Control::dump_trace_callback(
+  const mujoco_ros2_control_msgs::srv::DumpTrace::Request::SharedPtr request,
+  mujoco_ros2_control_msgs::srv::DumpTrace::Response::SharedPtr response)
+{
+  auto path = request->path;
+  if (path.empty())
+  {
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch());
+    path = "trace_" + std::to_string(now.count()) + ".json";
+  }
+
+  long event_count = tracer_->dump(path);
+  response->success = event_count >= 0;
+  response->event_count = std::max(event_count, 0L);
+  response->message = response->success ? "Trace has been written to " + path : "Failed to write trace to " + path;
+  RCLCPP_INFO_STREAM(logger_, response->message);
+}
+
+void MujocoRos2Control::settle()
+{
+  // one forward pass for the initial poses written by all hardware components
+  mj_forward(mj_model_, mj_data_);
+
+  auto duration = node_->get_parameter_or<double>("settle_duration", 0.0);
+  auto velocity_threshold = node_->get_parameter_or<double>("settle_velocity_threshold", 0.0);
+  auto snapshot_path = node_->get_parameter_or<std::string>("settle_snapshot_path", "");
+  if (duration <= 0.0)
+  {
+    return;
+  }
+
+  // a snapshot only holds for the model and the initial pose it was settled from
+  std::vector<mjtNum> fingerprint = {
+    static_cast<mjtNum>(mj_model_->nq), static_cast<mjtNum>(mj_model_->nv), static_cast<mjtNum>(mj_model_->nbody),
+    mj_model_->opt.timestep};
+  fingerprint.insert(fingerprint.end(), mj_data_->qpos, mj_data_->qpos + mj_model_->nq);
+
+  std::vector<mjtNum> state(mj_stateSize(mj_model_, mjSTATE_INTEGRATION));
+  if (!snapshot_path.empty() && load_snapshot(snapshot_path, fingerprint, state))
+  {
+    mj_setState(mj_model_, mj_data_, state.data(), mjSTATE_INTEGRATION);
+    mj_forward(mj_model_, mj_data_);
+    RCLCPP_INFO_STREAM(logger_, "Settled state has been loaded from " << snapshot_path);
+    return;
+  }
+
+  // hinge and slide joints are held at their initial pose, so that the robot does not collapse
+  // while free bodies and contacts settle
+  std::vector<std::pair<int, int>> held_joints;  // qpos and qvel address
+  std::vector<mjtNum> held_positions;
+  for (int id = 0; id < mj_model_->njnt; id++)
+  {
+    if (mj_model_->jnt_type[id] == mjJNT_HINGE || mj_model_->jnt_type[id] == mjJNT_SLIDE)
+    {
+      held_joints.emplace_back(mj_model_->jnt_qposadr[id], mj_model_->jnt_dofadr[id]);
+      held_positions.push_back(mj_data_->qpos[mj_model_->jnt_qposadr[id]]);
+    }
+  }
+
+  // with a velocity threshold, stop once all velocities stayed below it for this long
+  const double calm_duration = 0.1;
+  double start_time = mj_data_->time;
+  double calm_since = start_time;
+  long steps = 0;
+  while (mj_data_->time - start_time < duration)
+  {
+    mj_step(mj_model_, mj_data_);
+    for (size_t i = 0; i < held_joints.size(); i++)
+    {
+      mj_data_->qpos[held_joints[i].first] = held_positions[i];
+      mj_data_->qvel[held_joints[i].second] = 0.0;
+    }
+    steps++;
+
+    if (velocity_threshold > 0.0)
+    {
+      mjtNum max_velocity = 0.0;
+      for (int dof = 0; dof < mj_model_->nv; dof++)
+      {
+        max_velocity = std::max(max_velocity, std::abs(mj_data_->qvel[dof]));
+      }
+      if (max_velocity >= velocity_threshold)
+      {
+        calm_since = mj_data_->time;
+      }
+      else if (mj_data_->time - calm_since >= calm_duration)
+      {
+        break;
+      }
+    }
+  }
+  RCLCPP_INFO_STREAM(logger_, "Settled for " << mj_data_->time - start_time << " s in " << steps << " steps");
+
+  // experiments start from the settled state at the original time
+  mj_data_->time = start_time;
+  mj_forward(mj_model_, mj_data_);
+
+  if (!snapshot_path.empty())
+  {
+    mj_getState(mj_model_, mj_data_, state.data(), mjSTATE_INTEGRATION);
+    save_snapshot(snapshot_path, fingerprint, state);
+  }
+}
+
+bool MujocoRos2Control::load_snapshot(
+  const std::string & path, const std::vector<mjtNum> & fingerprint, std::vector<mjtNum> & state)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+
+  // the fingerprint and the state size are stored first, to reject snapshots of another model or pose
+  int fingerprint_size = 0;
+  file.read(reinterpret_cast<char*>(&fingerprint_size), sizeof(fingerprint_size));
+  std::vector<mjtNum> stored_fingerprint(fingerprint_size == static_cast<int>(fingerprint.size()) ? fingerprint_size : 0);
+  file.read(reinterpret_cast<char*>(stored_fingerprint.data()), stored_fingerprint.size() * sizeof(mjtNum));
+  int size = 0;
+  file.read(reinterpret_cast<char*>(&size), sizeof(size));
+  if (!file || stored_fingerprint != fingerprint || size != static_cast<int>(state.size()))
+  {
+    RCLCPP_WARN_STREAM(logger_, "Ignoring settled state " << path << ", it does not match the model or the initial pose");
+    return false;
+  }
+  file.read(reinterpret_cast<char*>(state.data()), state.size() * sizeof(mjtNum));
+  return static_cast<bool>(file);
+}
+
+void MujocoRos2Control::save_snapshot(
+  const std::string & path, const std::vector<mjtNum> & fingerprint, const std::vector<mjtNum> & state)
+{
+  std::ofstream file(path, std::ios::binary);
+  int fingerprint_size = static_cast<int>(fingerprint.size());
+  file.write(reinterpret_cast<const char*>(&fingerprint_size), sizeof(fingerprint_size));
+  file.write(reinterpret_cast<const char*>(fingerprint.data()), fingerprint.size() * sizeof(mjtNum));
+  int size = static_cast<int>(state.size());
+  file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  file.write(reinterpret_cast<const char*>(state.data()), state.size() * sizeof(mjtNum));
+  if (!file)
+  {
+    RCLCPP_WARN_STREAM(logger_, "Failed to save settled state to " << path);
+    return;
+  }
+  RCLCPP_INFO_STREAM(logger_, "Settled state has been saved to " << path);
 }
 
 void MujocoRos2Control::update()
 {
-  // Get the simulation time and period
-  auto sim_time = mj_data_->time;
-  int sim_time_sec = static_cast<int>(sim_time);
-  int sim_time_nanosec = static_cast<int>((sim_time - sim_time_sec)*1000000000);
+  ScopedTrace step_trace(tracer_.get(), "step");
 
-  rclcpp::Time sim_time_ros(sim_time_sec, sim_time_nanosec, RCL_ROS_TIME);
+  // a reloaded model is swapped in between two steps
+  if (reload_requested_.load(std::memory_order_acquire))
+  {
+    ScopedTrace trace(tracer_.get(), "reload_model");
+    apply_model_reload();
+  }
+
+  // Get the simulation time and period
+  rclcpp::Time sim_time_ros = get_sim_time();
   rclcpp::Duration sim_period = sim_time_ros - last_update_sim_time_ros_;
 
-  publish_sim_time(sim_time_ros);
+  {
+    ScopedTrace trace(tracer_.get(), "publish_clock");
+    publish_sim_time(sim_time_ros);
+  }
 
-  mj_step1(mj_model_, mj_data_);
+  // external wrenches are rebuilt every step by the injector and the hardware components
+  mju_zero(mj_data_->xfrc_applied, 6 * mj_model_->nbody);
+  if (wrench_injector_)
+  {
+    wrench_injector_->update();
+  }
+
+  {
+    ScopedTrace trace(tracer_.get(), "mj_step1");
+    mj_step1(mj_model_, mj_data_);
+  }
 
   if (sim_period >= control_period_) {
-    controller_manager_->read(sim_time_ros, sim_period);
-    controller_manager_->update(sim_time_ros, sim_period);
+    if (pipelined_control_) {
+      // the controllers computed on the previous tick's state, their commands take effect now,
+      // one control period late, while they compute on this tick's state next to the physics
+      {
+        ScopedTrace trace(tracer_.get(), "wait_control_update");
+        wait_control_update();
+      }
+      latch_commands();
+      {
+        ScopedTrace trace(tracer_.get(), "read");
+        controller_manager_->read(sim_time_ros, sim_period);
+      }
+      start_control_update(sim_time_ros, sim_period);
+    } else {
+      {
+        ScopedTrace trace(tracer_.get(), "read");
+        controller_manager_->read(sim_time_ros, sim_period);
+      }
+      {
+        ScopedTrace trace(tracer_.get(), "update");
+        controller_manager_->update(sim_time_ros, sim_period);
+      }
+      latch_commands();
+    }
     last_update_sim_time_ros_ = sim_time_ros;
   }
 
   // use same time as for read and update call - this is how it is done in ros2_control_node
-  controller_manager_->write(sim_time_ros, sim_period);
+  {
+    ScopedTrace trace(tracer_.get(), "write");
+    controller_manager_->write(sim_time_ros, sim_period);
+  }
 
-  mj_step2(mj_model_, mj_data_);
+  {
+    ScopedTrace trace(tracer_.get(), "mj_step2");
+    mj_step2(mj_model_, mj_data_);
+  }
+
+  ScopedTrace trace(tracer_.get(), "step_hooks");
+  if (contact_exporter_)
+  {
+    contact_exporter_->update(sim_time_ros);
+  }
+  if (pose_publisher_)
+  {
+    pose_publisher_->update(sim_time_ros);
+  }
+  if (state_validator_)
+  {
+    state_validator_->update();
+  }
+  if (model_query_)
+  {
+    model_query_->update();
+  }
+  if (linearizer_)
+  {
+    linearizer_->update();
+  }
+}
+
+bool MujocoRos2Control::activate_controllers(const std::vector<std::string> & controller_names)
+{
+  // the controller manager is updated from this thread below
+  if (pipelined_control_)
+  {
+    wait_control_update();
+  }
+
+  auto activation = std::async(std::launch::async, [this, &controller_names]()
+    {
+      for (const auto& controller_name : controller_names)
+      {
+        if (!controller_manager_->load_controller(controller_name))
+        {
+          RCLCPP_ERROR_STREAM(logger_, "Failed to load controller: " << controller_name);
+          return false;
+        }
+        if (controller_manager_->configure_controller(controller_name) != controller_interface::return_type::OK)
+        {
+          RCLCPP_ERROR_STREAM(logger_, "Failed to configure controller: " << controller_name);
+          return false;
+        }
+      }
+      return controller_manager_->switch_controller(
+        controller_names, {}, controller_manager_msgs::srv::SwitchController::Request::STRICT) ==
+        controller_interface::return_type::OK;
+    });
+
+  // Loading and switching wait for the control loop to pick up the new controller list,
+  // so keep the controller manager updating without advancing the physics meanwhile.
+  while (activation.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready)
+  {
+    controller_manager_->update(get_sim_time(), rclcpp::Duration(0, 0));
+    latch_commands();
+  }
+
+  return activation.get();
+}
+
+void MujocoRos2Control::latch_commands()
+{
+  for (auto mujoco_system : mujoco_systems_)
+  {
+    mujoco_system->latch_commands();
+  }
+}
+
+void MujocoRos2Control::run_control_thread()
+{
+  configure_thread(
+    "controller_update", node_->get_parameter_or<int>("control_thread_priority", 0),
+    node_->get_parameter_or<int>("control_thread_cpu", -1));
+
+  std::unique_lock<std::mutex> lock(control_mutex_);
+  while (true)
+  {
+    control_cv_.wait(lock, [this]() { return control_update_pending_ || stop_control_thread_; });
+    if (stop_control_thread_)
+    {
+      return;
+    }
+
+    auto time = control_update_time_;
+    auto period = control_update_period_;
+    lock.unlock();
+    {
+      ScopedTrace trace(tracer_.get(), "update");
+      controller_manager_->update(time, period);
+    }
+    lock.lock();
+
+    control_update_pending_ = false;
+    control_cv_.notify_all();
+  }
+}
+
+void MujocoRos2Control::start_control_update(const rclcpp::Time & time, const rclcpp::Duration & period)
+{
+  {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    control_update_time_ = time;
+    control_update_period_ = period;
+    control_update_pending_ = true;
+  }
+  control_cv_.notify_all();
+}
+
+void MujocoRos2Control::wait_control_update()
+{
+  std::unique_lock<std::mutex> lock(control_mutex_);
+  control_cv_.wait(lock, [this]() { return !control_update_pending_; });
+}
+
+rclcpp::Time MujocoRos2Control::get_sim_time() const
+{
+  auto sim_time = mj_data_->time;
+  int sim_time_sec = static_cast<int>(sim_time);
+  int sim_time_nanosec = static_cast<int>((sim_time - sim_time_sec)*1000000000);
+
+  return rclcpp::Time(sim_time_sec, sim_time_nanosec, RCL_ROS_TIME);
+}
+
+void MujocoRos2Control::configure_realtime()
+{
+  // the mask the process was started with, before any thread is pinned
+  CPU_ZERO(&default_cpu_set_);
+  if (sched_getaffinity(0, sizeof(default_cpu_set_), &default_cpu_set_) != 0)
+  {
+    RCLCPP_WARN_STREAM(logger_, "Failed to get the cpu affinity: " << std::strerror(errno));
+  }
+
+  sim_thread_priority_ = node_->get_parameter_or<int>("sim_thread_priority", 0);
+  sim_thread_cpu_ = node_->get_parameter_or<int>("sim_thread_cpu", -1);
+  cm_thread_priority_ = node_->get_parameter_or<int>("cm_thread_priority", 0);
+  cm_thread_cpu_ = node_->get_parameter_or<int>("cm_thread_cpu", -1);
+
+  if (node_->get_parameter_or<bool>("lock_memory", false))
+  {
+    // Keep all current and future pages resident and never give heap memory back to the OS,
+    // so that the step loop does not page fault once running.
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+      RCLCPP_WARN_STREAM(logger_, "Failed to lock memory: " << std::strerror(errno));
+    }
+    else
+    {
+      mallopt(M_TRIM_THRESHOLD, -1);
+      mallopt(M_MMAP_MAX, 0);
+
+      auto prefault_size = node_->get_parameter_or<int>("prefault_heap_size_mb", 0) * 1024L * 1024L;
+      if (prefault_size > 0)
+      {
+        auto heap = static_cast<volatile char *>(malloc(prefault_size));
+        if (heap != nullptr)
+        {
+          const auto page_size = sysconf(_SC_PAGESIZE);
+          for (long i = 0; i < prefault_size; i += page_size)
+          {
+            heap[i] = 0;
+          }
+          free(const_cast<char *>(heap));
+        }
+      }
+      RCLCPP_INFO_STREAM(logger_, "Memory locked, prefaulted heap: " << prefault_size << " bytes");
+    }
+  }
+}
+
+void MujocoRos2Control::configure_thread(const std::string & thread_name, int priority, int cpu)
+{
+  if (tracer_)
+  {
+    tracer_->set_thread_name(thread_name);
+  }
+
+  // threads inherit the settings of the thread spawning them, so the defaults are set explicitly
+  if (cpu >= 0)
+  {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (result != 0)
+    {
+      RCLCPP_WARN_STREAM(logger_, "Failed to pin " << thread_name << " thread to cpu " << cpu << ": " << std::strerror(result));
+    }
+  }
+  else
+  {
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(default_cpu_set_), &default_cpu_set_);
+    if (result != 0)
+    {
+      RCLCPP_WARN_STREAM(logger_, "Failed to reset the cpu affinity of " << thread_name << " thread: " << std::strerror(result));
+    }
+  }
+
+  sched_param param;
+  param.sched_priority = priority > 0 ? priority : 0;
+  int policy = priority > 0 ? SCHED_FIFO : SCHED_OTHER;
+  int result = pthread_setschedparam(pthread_self(), policy, &param);
+  if (result != 0 && priority > 0)
+  {
+    RCLCPP_WARN_STREAM(logger_, "Failed to set SCHED_FIFO priority " << priority << " for " << thread_name << " thread: " << std::strerror(result));
+  }
+  else if (result != 0)
+  {
+    RCLCPP_WARN_STREAM(logger_, "Failed to reset the scheduler of " << thread_name << " thread: " << std::strerror(result));
+  }
+}
+
+rclcpp::Executor::SharedPtr MujocoRos2Control::create_executor()
+{
+  auto executor_type = node_->get_parameter_or<std::string>("cm_executor_type", "single_threaded");
+  if (tracer_ && executor_type != "single_threaded")
+  {
+    RCLCPP_WARN_STREAM(logger_, "Only the single_threaded executor records its callbacks in the trace");
+  }
+  if (executor_type == "multi_threaded")
+  {
+    // 0 lets rclcpp pick the number of hardware threads
+    auto number_of_threads = node_->get_parameter_or<int>("cm_executor_threads", 0);
+    return std::make_shared<rclcpp::executors::MultiThreadedExecutor>(
+      rclcpp::ExecutorOptions(), static_cast<size_t>(std::max(number_of_threads, 0)));
+  }
+  else if (executor_type == "single_threaded")
+  {
+    if (tracer_)
+    {
+      return std::make_shared<TracedExecutor>(tracer_.get());
+    }
+    return std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+  }
+  else if (executor_type == "static_single_threaded")
+  {
+    return std::make_shared<rclcpp::executors::StaticSingleThreadedExecutor>();
+  }
+#ifdef MUJOCO_ROS2_CONTROL_HAS_EVENTS_EXECUTOR
+  else if (executor_type == "events")
+  {
+    return std::make_shared<rclcpp::experimental::executors::EventsExecutor>();
+  }
+#endif
+
+  RCLCPP_ERROR_STREAM(logger_, "Unknown or unsupported executor type: " << executor_type);
+  return nullptr;
+}
+
+void MujocoRos2Control::set_clock_decimation(int decimation)
+{
+  clock_decimation_ = std::max(1, decimation);
+}
+
+MujocoStateValidator* MujocoRos2Control::get_state_validator() const
+{
+  return state_validator_.get();
+}
+
+MujocoModelQuery* MujocoRos2Control::get_model_query() const
+{
+  return model_query_.get();
+}
+
+MujocoLinearizer* MujocoRos2Control::get_linearizer() const
+{
+  return linearizer_.get();
+}
+
+MujocoTracer* MujocoRos2Control::get_tracer() const
+{
+  return tracer_.get();
+}
+
+void MujocoRos2Control::set_model_reload_callback(std::function<void(mjModel*, mjData*)> callback)
+{
+  reload_callback_ = std::move(callback);
 }
 
 void MujocoRos2Control::publish_sim_time(rclcpp::Time sim_time)
 {
   // TODO
+  if (!publish_clock_ || ++clock_counter_ < clock_decimation_)
+  {
+    return;
+  }
+  clock_counter_ = 0;
   rosgraph_msgs::msg::Clock sim_time_msg;
   sim_time_msg.clock = sim_time;
   clock_publisher_->publish(sim_time_msg);
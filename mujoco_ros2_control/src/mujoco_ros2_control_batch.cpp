@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+
+#include "rclcpp/rclcpp.hpp"
+#include "mujoco/mujoco.h"
+#include "yaml-cpp/yaml.h"
+
+#include "mujoco_ros2_control/mujoco_ros2_control.hpp"
+#include "mujoco_ros2_control/mujoco_model_options.hpp"
+
+// Runs one scenario headless and as fast as the physics allows: loads the model, activates the
+// controllers in-process, simulates for a fixed duration and writes a compact metrics file.
+
+struct JointMetrics
+{
+  std::string name;
+  int mj_pos_adr;
+  int mj_vel_adr;
+  double max_abs_position {0.0};
+  double max_abs_velocity {0.0};
+  double max_abs_effort {0.0};
+  double effort_squared_integral {0.0};
+};
+
+// main function
+int main(int argc, const char** argv) {
+
+  rclcpp::init(argc, argv);
+  std::shared_ptr<rclcpp::Node> node = rclcpp::Node::make_shared("mujoco_ros2_control_node", rclcpp::NodeOptions().automatically_declare_parameters_from_overrides(true));
+
+  // nobody listens to the simulated clock in a batch run, unless asked for
+  if (!node->has_parameter("publish_clock"))
+  {
+    node->declare_parameter("publish_clock", false);
+  }
+
+  RCLCPP_INFO_STREAM(node->get_logger(), "Initializing mujoco_ros2_control batch run...");
+  auto model_path = node->get_parameter("mujoco_model_path").as_string();
+  auto duration = node->get_parameter_or<double>("duration", 10.0);
+  auto controllers = node->get_parameter_or<std::vector<std::string>>("controllers", {});
+  auto metrics_path = node->get_parameter_or<std::string>("metrics_path", "metrics.yaml");
+
+  // load and compile model
+  std::string error;
+  mjModel* mujoco_model = mujoco_ros2_control::load_model(model_path, error);
+  if (!mujoco_model) {
+    mju_error("Load model error: %s", error.c_str());
+  }
+  mujoco_ros2_control::apply_solver_options(node, mujoco_model);
+  mjData* mujoco_data = mj_makeData(mujoco_model);
+  mujoco_ros2_control::MujocoThreadPool thread_pool(node, mujoco_data);
+
+  // scalar joints are tracked, ball and free joints have no single position to report
+  std::vector<JointMetrics> joint_metrics;
+  for (int id = 0; id < mujoco_model->njnt; id++)
+  {
+    const char* name = mj_id2name(mujoco_model, mjtObj::mjOBJ_JOINT, id);
+    if (name == nullptr || (mujoco_model->jnt_type[id] != mjJNT_HINGE && mujoco_model->jnt_type[id] != mjJNT_SLIDE))
+    {
+      continue;
+    }
+    JointMetrics metrics;
+    metrics.name = name;
+    metrics.mj_pos_adr = mujoco_model->jnt_qposadr[id];
+    metrics.mj_vel_adr = mujoco_model->jnt_dofadr[id];
+    joint_metrics.push_back(metrics);
+  }
+
+  bool success = false;
+  long steps = 0;
+  double wall_time = 0.0;
+  {
+    mujoco_ros2_control::MujocoRos2Control control(node, mujoco_model, mujoco_data);
+    if (control.init() && control.activate_controllers(controllers))
+    {
+      auto wall_start = std::chrono::steady_clock::now();
+      while (rclcpp::ok() && mujoco_data->time < duration)
+      {
+        control.update();
+        for (auto& metrics : joint_metrics)
+        {
+          double effort = mujoco_data->qfrc_applied[metrics.mj_vel_adr];
+          metrics.max_abs_position = std::max(metrics.max_abs_position, std::abs(mujoco_data->qpos[metrics.mj_pos_adr]));
+          metrics.max_abs_velocity = std::max(metrics.max_abs_velocity, std::abs(mujoco_data->qvel[metrics.mj_vel_adr]));
+          metrics.max_abs_effort = std::max(metrics.max_abs_effort, std::abs(effort));
+          metrics.effort_squared_integral += effort * effort * mujoco_model->opt.timestep;
+        }
+        steps++;
+      }
+      wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+      success = mujoco_data->time >= duration;
+    }
+    else
+    {
+      RCLCPP_ERROR_STREAM(node->get_logger(), "Failed to initialize mujoco_ros2_control or to activate the controllers");
+    }
+  }
+
+  YAML::Emitter metrics;
+  metrics << YAML::BeginMap;
+  metrics << YAML::Key << "model" << YAML::Value << model_path;
+  metrics << YAML::Key << "success" << YAML::Value << success;
+  metrics << YAML::Key << "sim_time" << YAML::Value << mujoco_data->time;
+  metrics << YAML::Key << "wall_time" << YAML::Value << wall_time;
+  metrics << YAML::Key << "real_time_factor" << YAML::Value << (wall_time > 0.0 ? mujoco_data->time / wall_time : 0.0);
+  metrics << YAML::Key << "steps" << YAML::Value << steps;
+  metrics << YAML::Key << "solver" << YAML::Value << YAML::Flow << YAML::BeginMap;
+  metrics << YAML::Key << "type" << YAML::Value << mujoco_ros2_control::get_solver_name(mujoco_model->opt.solver);
+  metrics << YAML::Key << "iterations" << YAML::Value << mujoco_model->opt.iterations;
+  metrics << YAML::Key << "tolerance" << YAML::Value << mujoco_model->opt.tolerance;
+  metrics << YAML::Key << "noslip_iterations" << YAML::Value << mujoco_model->opt.noslip_iterations;
+  metrics << YAML::Key << "island" << YAML::Value << static_cast<bool>(mujoco_model->opt.enableflags & mjENBL_ISLAND);
+  metrics << YAML::Key << "threads" << YAML::Value << thread_pool.size();
+  metrics << YAML::EndMap;
+  metrics << YAML::Key << "joints" << YAML::Value << YAML::BeginMap;
+  for (const auto& joint : joint_metrics)
+  {
+    metrics << YAML::Key << joint.name << YAML::Value << YAML::Flow << YAML::BeginMap;
+    metrics << YAML::Key << "final_position" << YAML::Value << mujoco_data->qpos[joint.mj_pos_adr];
+    metrics << YAML::Key << "final_velocity" << YAML::Value << mujoco_data->qvel[joint.mj_vel_adr];
+    metrics << YAML::Key << "max_abs_position" << YAML::Value << joint.max_abs_position;
+    metrics << YAML::Key << "max_abs_velocity" << YAML::Value << joint.max_abs_velocity;
+    metrics << YAML::Key << "max_abs_effort" << YAML::Value << joint.max_abs_effort;
+    metrics << YAML::Key << "effort_rms" << YAML::Value <<
+      (mujoco_data->time > 0.0 ? std::sqrt(joint.effort_squared_integral / mujoco_data->time) : 0.0);
+    metrics << YAML::EndMap;
+  }
+  metrics << YAML::EndMap;
+  metrics << YAML::EndMap;
+
+  std::ofstream(metrics_path) << metrics.c_str() << "\n";
+  RCLCPP_INFO_STREAM(node->get_logger(), "Metrics have been written to " << metrics_path);
+
+  // free MuJoCo model and data
+  mj_deleteData(mujoco_data);
+  mj_deleteModel(mujoco_model);
+  rclcpp::shutdown();
+
+  return success ? 0 : 1;
+}
@@ -1,9 +1,12 @@
+#include <chrono>
 
 #include "rclcpp/rclcpp.hpp"
 #include "mujoco/mujoco.h"
 
 #include "mujoco_ros2_control/mujoco_ros2_control.hpp"
+#include "mujoco_ros2_control/mujoco_model_options.hpp"
 #include "mujoco_ros2_control/mujoco_rendering.hpp"
+#include "mujoco_ros2_control/step_budget_watchdog.hpp"
 
 // MuJoCo data structures
 mjModel* mujoco_model = nullptr;
@@ -19,22 +22,22 @@ int main(int argc, const char** argv) {
   auto model_path = node->get_parameter("mujoco_model_path").as_string();
 
   // load and compile model
-  char error[1000] = "Could not load binary model";
-  if (std::strlen(model_path.c_str())>4 && !std::strcmp(model_path.c_str()+std::strlen(model_path.c_str())-4, ".mjb")) {
-    mujoco_model = mj_loadModel(model_path.c_str(), 0);
-  } else {
-    mujoco_model = mj_loadXML(model_path.c_str(), 0, error, 1000);
-  }
+  auto load_start = std::chrono::steady_clock::now();
+  std::string error;
+  mujoco_model = mujoco_ros2_control::load_model(model_path, error);
   if (!mujoco_model) {
-    mju_error("Load model error: %s", error);
+    mju_error("Load model error: %s", error.c_str());
   }
 
-  RCLCPP_INFO_STREAM(node->get_logger(), "Mujoco model has been successfully loaded !");
+  double load_time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+  RCLCPP_INFO_STREAM(node->get_logger(), "Mujoco model has been successfully loaded in " << load_time_ms << " ms !");
+  mujoco_ros2_control::apply_solver_options(node, mujoco_model);
   // make data
   mujoco_data = mj_makeData(mujoco_model);
+  mujoco_ros2_control::MujocoThreadPool thread_pool(node, mujoco_data);
 
   // initialize mujoco control
-  auto control = mujoco_ros2_control::MujocoRos2Control(node, mujoco_model, mujoco_data);
+  mujoco_ros2_control::MujocoRos2Control control(node, mujoco_model, mujoco_data);
   control.init();
   RCLCPP_INFO_STREAM(node->get_logger(), "Mujoco ros2 controller has been successfully initialized !");
 
@@ -43,17 +46,36 @@ int main(int argc, const char** argv) {
   rendering->init(node, mujoco_model, mujoco_data);
   RCLCPP_INFO_STREAM(node->get_logger(), "Mujoco rendering has been successfully initialized !");
 
+  // measure how long steps and frames take, and degrade gracefully if requested
+  const double frame_period = 1.0/60.0;
+  mujoco_ros2_control::StepBudgetWatchdog watchdog(node, mujoco_model, mujoco_data, control, frame_period);
+
+  // a reloaded model replaces the current one between two steps of control.update()
+  control.set_model_reload_callback([&](mjModel* reloaded_model, mjData* reloaded_data)
+    {
+      mujoco_model = reloaded_model;
+      mujoco_data = reloaded_data;
+      thread_pool.bind(mujoco_data);
+      rendering->reload(mujoco_model, mujoco_data);
+      watchdog.set_model(mujoco_model, mujoco_data);
+    });
+
   // run main loop, target real-time simulation and 60 fps rendering
   while (rclcpp::ok() && !rendering->is_close_flag_raised()) {
     // advance interactive simulation for 1/60 sec
     //  Assuming MuJoCo can simulate faster than real-time, which it usually can,
     //  this loop will finish on time for the next frame to be rendered at 60 fps.
-    //  Otherwise add a cpu timer and exit this loop when it is time to render.
+    //  Otherwise the watchdog accounts for the overrun.
     mjtNum simstart = mujoco_data->time;
-    while (mujoco_data->time - simstart < 1.0/60.0) {
+    while (mujoco_data->time - simstart < frame_period) {
+      watchdog.begin_step();
       control.update();
+      watchdog.end_step();
+    }
+    if (watchdog.end_frame()) {
+      mujoco_ros2_control::ScopedTrace trace(control.get_tracer(), "render");
+      rendering->update();
     }
-    rendering->update();
   }
 
   rendering->close();
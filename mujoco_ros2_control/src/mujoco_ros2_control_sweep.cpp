@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include "rclcpp/rclcpp.hpp"
+#include "mujoco/mujoco.h"
+#include "yaml-cpp/yaml.h"
+
+#include "mujoco_ros2_control/mujoco_ros2_control.hpp"
+#include "mujoco_ros2_control/mujoco_model_options.hpp"
+
+// Runs N perturbed copies of one compiled model concurrently, each with its own controller
+// manager in its own namespace, and writes one line of metrics per variant.
+
+struct Perturbation
+{
+  std::string parameter;
+  std::string name;
+  std::string mode;          // scale, offset or set
+  std::string distribution;  // uniform or normal
+  double a;                  // min or mean
+  double b;                  // max or standard deviation
+};
+
+struct SweepConfig
+{
+  int variants;
+  int threads;
+  unsigned int seed;
+  double duration;
+  std::vector<std::string> controllers;
+  std::string output;
+  std::vector<Perturbation> perturbations;
+};
+
+struct VariantResult
+{
+  std::vector<double> values;
+  bool success {false};
+  double sim_time {0.0};
+  double wall_time {0.0};
+  long steps {0};
+  double effort_integral {0.0};
+  std::vector<double> final_qpos;
+};
+
+SweepConfig load_sweep_config(const std::string & path)
+{
+  YAML::Node yaml = YAML::LoadFile(path);
+
+  SweepConfig config;
+  config.variants = yaml["variants"].as<int>(1);
+  config.threads = yaml["threads"].as<int>(static_cast<int>(std::thread::hardware_concurrency()));
+  config.seed = yaml["seed"].as<unsigned int>(0);
+  config.duration = yaml["duration"].as<double>(10.0);
+  config.output = yaml["output"].as<std::string>("sweep_results.csv");
+  if (yaml["controllers"])
+  {
+    config.controllers = yaml["controllers"].as<std::vector<std::string>>();
+  }
+
+  for (const auto& entry : yaml["perturbations"])
+  {
+    Perturbation perturbation;
+    perturbation.parameter = entry["parameter"].as<std::string>();
+    perturbation.name = entry["name"].as<std::string>();
+    perturbation.mode = entry["mode"].as<std::string>("scale");
+    perturbation.distribution = entry["distribution"].as<std::string>("uniform");
+    if (perturbation.distribution == "normal")
+    {
+      perturbation.a = entry["mean"].as<double>();
+      perturbation.b = entry["stddev"].as<double>();
+    }
+    else
+    {
+      perturbation.a = entry["min"].as<double>();
+      perturbation.b = entry["max"].as<double>();
+    }
+    config.perturbations.push_back(perturbation);
+  }
+
+  return config;
+}
+
+double apply(const std::string & mode, double nominal, double value)
+{
+  if (mode == "offset")
+  {
+    return nominal + value;
+  }
+  else if (mode == "set")
+  {
+    return value;
+  }
+  return nominal * value;
+}
+
+// Returns false if the perturbed object or parameter does not exist in the model
+bool apply_perturbation(mjModel* model, const Perturbation & perturbation, double value)
+{
+  if (perturbation.parameter == "body_mass")
+  {
+    int id = mj_name2id(model, mjtObj::mjOBJ_BODY, perturbation.name.c_str());
+    if (id == -1)
+    {
+      return false;
+    }
+    // keep the inertia consistent with the new mass
+    double mass = apply(perturbation.mode, model->body_mass[id], value);
+    double ratio = model->body_mass[id] > 0.0 ? mass / model->body_mass[id] : 1.0;
+    model->body_mass[id] = mass;
+    for (int i = 0; i < 3; i++)
+    {
+      model->body_inertia[3*id + i] *= ratio;
+    }
+  }
+  else if (perturbation.parameter == "geom_friction")
+  {
+    int id = mj_name2id(model, mjtObj::mjOBJ_GEOM, perturbation.name.c_str());
+    if (id == -1)
+    {
+      return false;
+    }
+    model->geom_friction[3*id] = apply(perturbation.mode, model->geom_friction[3*id], value);
+  }
+  else if (perturbation.parameter == "dof_damping" || perturbation.parameter == "dof_frictionloss" ||
+    perturbation.parameter == "dof_armature")
+  {
+    int id = mj_name2id(model, mjtObj::mjOBJ_JOINT, perturbation.name.c_str());
+    if (id == -1)
+    {
+      return false;
+    }
+    mjtNum* field = perturbation.parameter == "dof_damping" ? model->dof_damping :
+      perturbation.parameter == "dof_frictionloss" ? model->dof_frictionloss : model->dof_armature;
+    int dof_end = id + 1 < model->njnt ? model->jnt_dofadr[id + 1] : model->nv;
+    for (int dof = model->jnt_dofadr[id]; dof < dof_end; dof++)
+    {
+      field[dof] = apply(perturbation.mode, field[dof], value);
+    }
+  }
+  else if (perturbation.parameter == "actuator_gain")
+  {
+    int id = mj_name2id(model, mjtObj::mjOBJ_ACTUATOR, perturbation.name.c_str());
+    if (id == -1)
+    {
+      return false;
+    }
+    model->actuator_gainprm[id*mjNGAIN] = apply(perturbation.mode, model->actuator_gainprm[id*mjNGAIN], value);
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+VariantResult run_variant(
+  rclcpp::Node::SharedPtr & node, const mjModel* base_model, const SweepConfig & config, int variant)
+{
+  VariantResult result;
+  auto logger = node->get_logger();
+
+  // each variant draws from its own stream so results do not depend on scheduling
+  std::mt19937 generator(config.seed + variant);
+  mjModel* model = mj_copyModel(nullptr, base_model);
+  for (const auto& perturbation : config.perturbations)
+  {
+    double value;
+    if (perturbation.distribution == "normal")
+    {
+      value = std::normal_distribution<double>(perturbation.a, perturbation.b)(generator);
+    }
+    else
+    {
+      value = std::uniform_real_distribution<double>(perturbation.a, perturbation.b)(generator);
+    }
+    result.values.push_back(value);
+
+    if (!apply_perturbation(model, perturbation, value))
+    {
+      RCLCPP_ERROR_STREAM(logger, "Variant " << variant << ": cannot perturb " << perturbation.parameter << " of " << perturbation.name);
+      mj_deleteModel(model);
+      return result;
+    }
+  }
+
+  mjData* data = mj_makeData(model);
+  // recompute the constants derived from the perturbed masses and inertias
+  mj_setConst(model, data);
+
+  auto variant_node = rclcpp::Node::make_shared(
+    node->get_name(), node->get_namespace() + std::string(node->get_namespace() == std::string("/") ? "" : "/") +
+      "variant_" + std::to_string(variant),
+    rclcpp::NodeOptions()
+      .automatically_declare_parameters_from_overrides(true)
+      .parameter_overrides({
+        node->get_parameter("robot_description"),
+        rclcpp::Parameter("publish_clock", false)}));
+
+  {
+    mujoco_ros2_control::MujocoRos2Control control(variant_node, model, data);
+    if (control.init() && control.activate_controllers(config.controllers))
+    {
+      auto wall_start = std::chrono::steady_clock::now();
+      while (rclcpp::ok() && data->time < config.duration)
+      {
+        control.update();
+        for (int dof = 0; dof < model->nv; dof++)
+        {
+          result.effort_integral += data->qfrc_applied[dof] * data->qfrc_applied[dof] * model->opt.timestep;
+        }
+        result.steps++;
+      }
+      result.wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+      result.sim_time = data->time;
+      result.final_qpos.assign(data->qpos, data->qpos + model->nq);
+      result.success = true;
+    }
+    else
+    {
+      RCLCPP_ERROR_STREAM(logger, "Variant " << variant << ": failed to initialize mujoco_ros2_control");
+    }
+  }
+
+  mj_deleteData(data);
+  mj_deleteModel(model);
+  return result;
+}
+
+void write_results(
+  const std::string & path, const mjModel* model, const SweepConfig & config, const std::vector<VariantResult> & results)
+{
+  std::ofstream file(path);
+  file << "variant,success";
+  for (const auto& perturbation : config.perturbations)
+  {
+    file << "," << perturbation.name << "." << perturbation.parameter;
+  }
+  file << ",sim_time,wall_time,real_time_factor,steps,effort_integral";
+  for (int i = 0; i < model->nq; i++)
+  {
+    file << ",qpos_" << i;
+  }
+  file << "\n";
+
+  for (size_t variant = 0; variant < results.size(); variant++)
+  {
+    const auto& result = results.at(variant);
+    file << variant << "," << result.success;
+    for (const auto& value : result.values)
+    {
+      file << "," << value;
+    }
+    // keep the columns aligned for variants which failed before drawing all values
+    for (size_t i = result.values.size(); i < config.perturbations.size(); i++)
+    {
+      file << ",";
+    }
+    file << "," << result.sim_time << "," << result.wall_time << ","
+         << (result.wall_time > 0.0 ? result.sim_time / result.wall_time : 0.0) << ","
+         << result.steps << "," << result.effort_integral;
+    for (int i = 0; i < model->nq; i++)
+    {
+      file << ",";
+      if (i < static_cast<int>(result.final_qpos.size()))
+      {
+        file << result.final_qpos.at(i);
+      }
+    }
+    file << "\n";
+  }
+}
+
+// main function
+int main(int argc, const char** argv) {
+
+  rclcpp::init(argc, argv);
+  std::shared_ptr<rclcpp::Node> node = rclcpp::Node::make_shared("mujoco_ros2_control_node", rclcpp::NodeOptions().automatically_declare_parameters_from_overrides(true));
+
+  RCLCPP_INFO_STREAM(node->get_logger(), "Initializing mujoco_ros2_control sweep...");
+  auto model_path = node->get_parameter("mujoco_model_path").as_string();
+  auto config = load_sweep_config(node->get_parameter("sweep_config_path").as_string());
+
+  // load and compile model once, variants are copied from it
+  std::string error;
+  mjModel* base_model = mujoco_ros2_control::load_model(model_path, error);
+  if (!base_model) {
+    mju_error("Load model error: %s", error.c_str());
+  }
+
+  std::vector<VariantResult> results(config.variants);
+  std::atomic<int> next_variant {0};
+  auto worker = [&]()
+    {
+      for (int variant = next_variant++; variant < config.variants && rclcpp::ok(); variant = next_variant++)
+      {
+        results.at(variant) = run_variant(node, base_model, config, variant);
+        RCLCPP_INFO_STREAM(node->get_logger(), "Variant " << variant << " finished");
+      }
+    };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < std::max(1, std::min(config.threads, config.variants)); i++)
+  {
+    workers.emplace_back(worker);
+  }
+  for (auto& thread : workers)
+  {
+    thread.join();
+  }
+
+  write_results(config.output, base_model, config, results);
+  RCLCPP_INFO_STREAM(node->get_logger(), "Sweep results have been written to " << config.output);
+
+  mj_deleteModel(base_model);
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -0,0 +1,230 @@
+#include "mujoco_ros2_control/mujoco_state_validator.hpp"
+
+#include <chrono>
+
+namespace mujoco_ros2_control
+{
+MujocoStateValidator::MujocoStateValidator(
+  rclcpp::Node::SharedPtr & node, const mjModel* mujoco_model, const mjData* mujoco_data, size_t threads)
+  : logger_(rclcpp::get_logger(node->get_name() + std::string(".state_validator"))),
+    mj_model_(mujoco_model), mj_data_(mujoco_data),
+    batch_positions_(nullptr), batch_allowed_penetration_(0.0), batch_results_(nullptr), batch_size_(0),
+    next_state_(0), batch_generation_(0), finished_workers_(0), stop_workers_(false)
+{
+  // constructed from the simulation thread, so the live state can be copied directly
+  live_qpos_.assign(mj_data_->qpos, mj_data_->qpos + mj_model_->nq);
+  live_mocap_pos_.assign(mj_data_->mocap_pos, mj_data_->mocap_pos + 3 * mj_model_->nmocap);
+  live_mocap_quat_.assign(mj_data_->mocap_quat, mj_data_->mocap_quat + 4 * mj_model_->nmocap);
+
+  for (int id = 0; id < mj_model_->nbody; id++)
+  {
+    const char* name = mj_id2name(mj_model_, mjtObj::mjOBJ_BODY, id);
+    body_names_.push_back(name ? name : "");
+  }
+
+  // the model is only read by mj_kinematics and mj_collision, the workers share it
+  for (size_t i = 0; i < threads; i++)
+  {
+    worker_data_.push_back(mj_makeData(mj_model_));
+  }
+  for (size_t i = 0; i < threads; i++)
+  {
+    workers_.emplace_back(&MujocoStateValidator::run_worker, this, i);
+  }
+
+  // not added to the node's default executor, MujocoRos2Control spins it on its services executor
+  callback_group_ = node->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+  service_ = node->create_service<mujoco_ros2_control_msgs::srv::CheckStateValidity>(
+    "~/check_state_validity",
+    [this](
+      const mujoco_ros2_control_msgs::srv::CheckStateValidity::Request::SharedPtr request,
+      mujoco_ros2_control_msgs::srv::CheckStateValidity::Response::SharedPtr response)
+    { service_callback(request, response); },
+    rmw_qos_profile_services_default, callback_group_);
+}
+
+MujocoStateValidator::~MujocoStateValidator()
+{
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex_);
+    stop_workers_ = true;
+  }
+  worker_cv_.notify_all();
+  for (auto& worker : workers_)
+  {
+    worker.join();
+  }
+  for (auto data : worker_data_)
+  {
+    mj_deleteData(data);
+  }
+}
+
+rclcpp::CallbackGroup::SharedPtr MujocoStateValidator::get_callback_group() const
+{
+  return callback_group_;
+}
+
+void MujocoStateValidator::update()
+{
+  live_state_.serve([this]()
+    {
+      live_qpos_.assign(mj_data_->qpos, mj_data_->qpos + mj_model_->nq);
+      live_mocap_pos_.assign(mj_data_->mocap_pos, mj_data_->mocap_pos + 3 * mj_model_->nmocap);
+      live_mocap_quat_.assign(mj_data_->mocap_quat, mj_data_->mocap_quat + 4 * mj_model_->nmocap);
+    });
+}
+
+bool MujocoStateValidator::request_live_state()
+{
+  return live_state_.request();
+}
+
+bool MujocoStateValidator::check_states(
+  const std::vector<std::string> & joint_names, const std::vector<double> & positions,
+  double allowed_penetration, std::vector<StateValidity> & results, std::string & error)
+{
+  if (joint_names.empty() || positions.size() % joint_names.size() != 0)
+  {
+    error = "The number of positions must be a multiple of the number of joints";
+    return false;
+  }
+
+  std::lock_guard<std::mutex> batch_lock(batch_mutex_);
+  batch_qpos_adr_.clear();
+  for (const auto& joint_name : joint_names)
+  {
+    int joint_id = mj_name2id(mj_model_, mjtObj::mjOBJ_JOINT, joint_name.c_str());
+    if (joint_id == -1)
+    {
+      error = "Failed to find joint in mujoco model, joint name: " + joint_name;
+      return false;
+    }
+    int joint_type = mj_model_->jnt_type[joint_id];
+    if (joint_type != mjtJoint::mjJNT_HINGE && joint_type != mjtJoint::mjJNT_SLIDE)
+    {
+      error = "Only hinge and slide joints can be set, joint name: " + joint_name;
+      return false;
+    }
+    batch_qpos_adr_.push_back(mj_model_->jnt_qposadr[joint_id]);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(live_state_.mutex());
+    batch_qpos_ = live_qpos_;
+    batch_mocap_pos_ = live_mocap_pos_;
+    batch_mocap_quat_ = live_mocap_quat_;
+  }
+
+  results.resize(positions.size() / joint_names.size());
+  batch_positions_ = positions.data();
+  batch_allowed_penetration_ = allowed_penetration;
+  batch_results_ = results.data();
+  batch_size_ = results.size();
+  next_state_.store(0);
+
+  // hand the batch to the workers and wait until all of them ran out of states
+  std::unique_lock<std::mutex> lock(worker_mutex_);
+  finished_workers_ = 0;
+  batch_generation_++;
+  worker_cv_.notify_all();
+  done_cv_.wait(lock, [this]() { return finished_workers_ == workers_.size(); });
+  return true;
+}
+
+void MujocoStateValidator::run_worker(size_t index)
+{
+  mjData* data = worker_data_[index];
+  size_t generation = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(worker_mutex_);
+      worker_cv_.wait(lock, [this, generation]() { return stop_workers_ || batch_generation_ != generation; });
+      if (stop_workers_)
+      {
+        return;
+      }
+      generation = batch_generation_;
+    }
+
+    for (size_t state = next_state_.fetch_add(1); state < batch_size_; state = next_state_.fetch_add(1))
+    {
+      check_state(data, state);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(worker_mutex_);
+      finished_workers_++;
+    }
+    done_cv_.notify_one();
+  }
+}
+
+void MujocoStateValidator::check_state(mjData* data, size_t state)
+{
+  mju_copy(data->qpos, batch_qpos_.data(), mj_model_->nq);
+  mju_copy(data->mocap_pos, batch_mocap_pos_.data(), 3 * mj_model_->nmocap);
+  mju_copy(data->mocap_quat, batch_mocap_quat_.data(), 4 * mj_model_->nmocap);
+  const double* positions = batch_positions_ + state * batch_qpos_adr_.size();
+  for (size_t i = 0; i < batch_qpos_adr_.size(); i++)
+  {
+    data->qpos[batch_qpos_adr_[i]] = positions[i];
+  }
+
+  mj_kinematics(mj_model_, data);
+  mj_collision(mj_model_, data);
+
+  auto& result = batch_results_[state];
+  result.penetration = 0.0;
+  result.geom1 = -1;
+  result.geom2 = -1;
+  // contacts are also generated within the margin of the geoms, with a positive distance
+  for (int i = 0; i < data->ncon; i++)
+  {
+    const auto& contact = data->contact[i];
+    if (-contact.dist > result.penetration)
+    {
+      result.penetration = -contact.dist;
+      result.geom1 = contact.geom[0];
+      result.geom2 = contact.geom[1];
+    }
+  }
+  result.valid = result.penetration <= batch_allowed_penetration_;
+}
+
+void MujocoStateValidator::service_callback(
+  const mujoco_ros2_control_msgs::srv::CheckStateValidity::Request::SharedPtr request,
+  mujoco_ros2_control_msgs::srv::CheckStateValidity::Response::SharedPtr response)
+{
+  if (!request_live_state())
+  {
+    RCLCPP_WARN_STREAM(logger_, "The simulation did not provide its state in time, checking against the last one");
+  }
+
+  std::vector<StateValidity> results;
+  response->success = check_states(
+    request->joint_names, request->positions, request->allowed_penetration, results, response->message);
+  if (!response->success)
+  {
+    return;
+  }
+
+  response->valid.resize(results.size());
+  response->penetration.resize(results.size());
+  response->body1.resize(results.size());
+  response->body2.resize(results.size());
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const auto& result = results[i];
+    response->valid[i] = result.valid;
+    response->penetration[i] = result.penetration;
+    // flex contacts have no geoms
+    if (result.geom1 >= 0 && result.geom2 >= 0)
+    {
+      response->body1[i] = body_names_[mj_model_->geom_bodyid[result.geom1]];
+      response->body2[i] = body_names_[mj_model_->geom_bodyid[result.geom2]];
+    }
+  }
+}
+}  // namespace mujoco_ros2_control
@@ -1,71 +1,390 @@
+#include <algorithm>
+#include <limits>
+#include <utility>
+
 #include "mujoco_ros2_control/mujoco_system.hpp"
 
 namespace mujoco_ros2_control
 {
-MujocoSystem::MujocoSystem() : logger_(rclcpp::get_logger(""))
+namespace
+{
+using JointState = MujocoSystem::JointState;
+
+enum class ControlMode
+{
+  POSITION,
+  POSITION_PID,
+  VELOCITY,
+  VELOCITY_PID,
+  EFFORT,
+};
+
+template <int JointType>
+struct JointDimensions
+{
+  static constexpr int nq = 1;
+  static constexpr int nv = 1;
+};
+
+template <>
+struct JointDimensions<mjJNT_BALL>
+{
+  static constexpr int nq = 4;
+  static constexpr int nv = 3;
+};
+
+template <>
+struct JointDimensions<mjJNT_FREE>
 {
+  static constexpr int nq = 7;
+  static constexpr int nv = 6;
+};
+
+// Interface names of the components of ball and free joints, in qpos/qvel order
+const std::array<std::string, 4> BALL_POSITION_NAMES {"orientation.w", "orientation.x", "orientation.y", "orientation.z"};
+const std::array<std::string, 3> BALL_VELOCITY_NAMES {"angular_velocity.x", "angular_velocity.y", "angular_velocity.z"};
+const std::array<std::string, 3> BALL_EFFORT_NAMES {"torque.x", "torque.y", "torque.z"};
+const std::array<std::string, 7> FREE_POSITION_NAMES {
+  "position.x", "position.y", "position.z", "orientation.w", "orientation.x", "orientation.y", "orientation.z"};
+const std::array<std::string, 6> FREE_VELOCITY_NAMES {
+  "velocity.x", "velocity.y", "velocity.z", "angular_velocity.x", "angular_velocity.y", "angular_velocity.z"};
+// also used for the components of force torque sensors
+const std::array<std::string, 6> FREE_EFFORT_NAMES {"force.x", "force.y", "force.z", "torque.x", "torque.y", "torque.z"};
+const std::array<std::string, 3> SCALAR_NAMES {
+  hardware_interface::HW_IF_POSITION, hardware_interface::HW_IF_VELOCITY, hardware_interface::HW_IF_EFFORT};
+
+template <size_t N>
+int find_component(const std::array<std::string, N> & names, const std::string & name)
+{
+  for (size_t i = 0; i < N; i++)
+  {
+    if (names[i] == name)
+    {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
 }
 
-std::vector<hardware_interface::StateInterface> MujocoSystem::export_state_interfaces()
+// index of a component state interface of a ball or free joint, -1 if it is not one
+int find_position_component(int joint_type, const std::string & name)
 {
-  std::vector<hardware_interface::StateInterface> new_state_interfaces;
+  return joint_type == mjJNT_BALL ? find_component(BALL_POSITION_NAMES, name) :
+    joint_type == mjJNT_FREE ? find_component(FREE_POSITION_NAMES, name) : -1;
+}
+
+int find_velocity_component(int joint_type, const std::string & name)
+{
+  return joint_type == mjJNT_BALL ? find_component(BALL_VELOCITY_NAMES, name) :
+    joint_type == mjJNT_FREE ? find_component(FREE_VELOCITY_NAMES, name) : -1;
+}
+
+int find_effort_component(int joint_type, const std::string & name)
+{
+  return joint_type == mjJNT_BALL ? find_component(BALL_EFFORT_NAMES, name) :
+    joint_type == mjJNT_FREE ? find_component(FREE_EFFORT_NAMES, name) : -1;
+}
+
+using InterfaceType = MujocoSystem::InterfaceType;
+
+// Position, velocity and effort control flags are indexed like SCALAR_NAMES
+size_t get_mode_index(InterfaceType type)
+{
+  switch (type)
+  {
+    case InterfaceType::POSITION:
+      return 0;
+    case InterfaceType::VELOCITY:
+      return 1;
+    default:
+      return 2;
+  }
+}
+
+bool & get_control_flag(JointState & joint_state, InterfaceType type)
+{
+  switch (get_mode_index(type))
+  {
+    case 0:
+      return joint_state.is_position_control_enabled;
+    case 1:
+      return joint_state.is_velocity_control_enabled;
+    default:
+      return joint_state.is_effort_control_enabled;
+  }
+}
+
+bool is_multi_dof(int joint_type)
+{
+  return joint_type == mjJNT_BALL || joint_type == mjJNT_FREE;
+}
+
+int get_dof_count(int joint_type)
+{
+  return joint_type == mjJNT_FREE ? JointDimensions<mjJNT_FREE>::nv :
+    joint_type == mjJNT_BALL ? JointDimensions<mjJNT_BALL>::nv : 1;
+}
+
+std::pair<double, double> get_position_bounds(const JointState & joint_state)
+{
+  double min_pos, max_pos;
+  min_pos = joint_state.joint_limits.has_position_limits ? joint_state.joint_limits.min_position : std::numeric_limits<double>::lowest();
+  min_pos = std::max(min_pos, joint_state.min_position_command);
+
+  max_pos = joint_state.joint_limits.has_position_limits ? joint_state.joint_limits.max_position : std::numeric_limits<double>::max();
+  max_pos = std::min(max_pos, joint_state.max_position_command);
+
+  return {min_pos, max_pos};
+}
+
+std::pair<double, double> get_velocity_bounds(const JointState & joint_state)
+{
+  double min_vel, max_vel;
+  min_vel = joint_state.joint_limits.has_velocity_limits ? -1*joint_state.joint_limits.max_velocity : std::numeric_limits<double>::lowest();
+  min_vel = std::max(min_vel, joint_state.min_velocity_command);
+
+  max_vel = joint_state.joint_limits.has_velocity_limits ? joint_state.joint_limits.max_velocity : std::numeric_limits<double>::max();
+  max_vel = std::min(max_vel, joint_state.max_velocity_command);
+
+  return {min_vel, max_vel};
+}
+
+std::pair<double, double> get_effort_bounds(const JointState & joint_state)
+{
+  double min_eff, max_eff;
+  min_eff = joint_state.joint_limits.has_effort_limits ? -1*joint_state.joint_limits.max_effort : std::numeric_limits<double>::lowest();
+  min_eff = std::max(min_eff, joint_state.min_effort_command);
 
-  for (auto& joint : joint_states_)
+  max_eff = joint_state.joint_limits.has_effort_limits ? joint_state.joint_limits.max_effort : std::numeric_limits<double>::max();
+  max_eff = std::min(max_eff, joint_state.max_effort_command);
+
+  return {min_eff, max_eff};
+}
+
+template <int JointType>
+void read_joints(std::vector<JointState> & joint_states, const size_t* begin, const size_t* end,
+  mjData* mujoco_data, uint64_t /* period */)
+{
+  constexpr int nq = JointDimensions<JointType>::nq;
+  constexpr int nv = JointDimensions<JointType>::nv;
+
+  for (auto it = begin; it != end; ++it)
   {
-    // Add state interfaces for joint hardware.
-    if (auto it = joint_hw_info_.find(joint.name); it != joint_hw_info_.end())
+    auto& joint_state = joint_states[*it];
+    if constexpr (nv == 1)
+    {
+      joint_state.position = mujoco_data->qpos[joint_state.mj_pos_adr];
+      joint_state.velocity = mujoco_data->qvel[joint_state.mj_vel_adr];
+      joint_state.effort = mujoco_data->qfrc_applied[joint_state.mj_vel_adr];
+    }
+    else
     {
-      for (const auto& state_if : it->second.state_interfaces)
+      std::copy_n(mujoco_data->qpos + joint_state.mj_pos_adr, nq, joint_state.positions.begin());
+      std::copy_n(mujoco_data->qvel + joint_state.mj_vel_adr, nv, joint_state.velocities.begin());
+      std::copy_n(mujoco_data->qfrc_applied + joint_state.mj_vel_adr, nv, joint_state.efforts.begin());
+    }
+  }
+}
+
+// With SkipUnchanged, effort joints whose command equals the last applied one are not written,
+// since qfrc_applied keeps its value between steps. All other modes depend on the stepped state.
+// With BiasFeedforward, PID joints add qfrc_bias, which mj_step1 computed before write(), to their output.
+template <int JointType, ControlMode Mode, bool SkipUnchanged = false, bool BiasFeedforward = false>
+void write_joints(std::vector<JointState> & joint_states, const size_t* begin, const size_t* end,
+  mjData* mujoco_data, uint64_t period)
+{
+  constexpr int nv = JointDimensions<JointType>::nv;
+  static_assert(nv == 1 || Mode == ControlMode::EFFORT, "Ball and free joints only support effort control");
+  static_assert(!SkipUnchanged || Mode == ControlMode::EFFORT, "Only effort commands can be skipped");
+  static_assert(!BiasFeedforward || Mode == ControlMode::POSITION_PID || Mode == ControlMode::VELOCITY_PID,
+    "Only PID commands have a bias feedforward");
+
+  for (auto it = begin; it != end; ++it)
+  {
+    auto& joint_state = joint_states[*it];
+    if constexpr (SkipUnchanged)
+    {
+      if constexpr (nv == 1)
       {
-        if (state_if.name == hardware_interface::HW_IF_POSITION)
-        {
-          new_state_interfaces.emplace_back(joint.name, hardware_interface::HW_IF_POSITION, &joint.position);
-        }
-        else if (state_if.name == hardware_interface::HW_IF_VELOCITY)
+        if (joint_state.effort_command == joint_state.applied_effort_commands[0])
         {
-          new_state_interfaces.emplace_back(joint.name, hardware_interface::HW_IF_VELOCITY, &joint.velocity);
+          continue;
         }
-        else if (state_if.name == hardware_interface::HW_IF_EFFORT)
+        joint_state.applied_effort_commands[0] = joint_state.effort_command;
+      }
+      else
+      {
+        if (std::equal(joint_state.effort_commands.begin(), joint_state.effort_commands.begin() + nv,
+          joint_state.applied_effort_commands.begin()))
         {
-          new_state_interfaces.emplace_back(joint.name, hardware_interface::HW_IF_EFFORT, &joint.effort);
+          continue;
         }
+        std::copy_n(joint_state.effort_commands.begin(), nv, joint_state.applied_effort_commands.begin());
+      }
+    }
+
+    if constexpr (Mode == ControlMode::POSITION)
+    {
+      mujoco_data->qpos[joint_state.mj_pos_adr] = joint_state.position_command;
+    }
+    else if constexpr (Mode == ControlMode::POSITION_PID)
+    {
+      double error = joint_state.position_command - mujoco_data->qpos[joint_state.mj_pos_adr];
+      double command = joint_state.position_pid.computeCommand(error, period);
+      if constexpr (BiasFeedforward)
+      {
+        command += mujoco_data->qfrc_bias[joint_state.mj_vel_adr];
       }
+      mujoco_data->qfrc_applied[joint_state.mj_vel_adr] = command;
     }
+    else if constexpr (Mode == ControlMode::VELOCITY)
+    {
+      mujoco_data->qvel[joint_state.mj_vel_adr] = joint_state.velocity_command;
+    }
+    else if constexpr (Mode == ControlMode::VELOCITY_PID)
+    {
+      double error = joint_state.velocity_command - mujoco_data->qvel[joint_state.mj_vel_adr];
+      double command = joint_state.velocity_pid.computeCommand(error, period);
+      if constexpr (BiasFeedforward)
+      {
+        command += mujoco_data->qfrc_bias[joint_state.mj_vel_adr];
+      }
+      mujoco_data->qfrc_applied[joint_state.mj_vel_adr] = command;
+    }
+    else if constexpr (nv == 1)
+    {
+      auto [min_eff, max_eff] = get_effort_bounds(joint_state);
+      mujoco_data->qfrc_applied[joint_state.mj_vel_adr] = std::clamp(joint_state.effort_command, min_eff, max_eff);
+    }
+    else
+    {
+      auto [min_eff, max_eff] = get_effort_bounds(joint_state);
+      for (int i = 0; i < nv; i++)
+      {
+        mujoco_data->qfrc_applied[joint_state.mj_vel_adr + i] = std::clamp(joint_state.effort_commands[i], min_eff, max_eff);
+      }
+    }
+  }
+}
+
+MujocoSystem::JointKernel select_read_kernel(int joint_type)
+{
+  switch (joint_type)
+  {
+    case mjJNT_FREE:
+      return &read_joints<mjJNT_FREE>;
+    case mjJNT_BALL:
+      return &read_joints<mjJNT_BALL>;
+    case mjJNT_SLIDE:
+      return &read_joints<mjJNT_SLIDE>;
+    case mjJNT_HINGE:
+      return &read_joints<mjJNT_HINGE>;
+    default:
+      return nullptr;
+  }
+}
+
+template <int JointType>
+MujocoSystem::JointKernel select_scalar_write_kernel(ControlMode mode, bool skip_unchanged, bool bias_feedforward)
+{
+  switch (mode)
+  {
+    case ControlMode::POSITION:
+      return &write_joints<JointType, ControlMode::POSITION>;
+    case ControlMode::POSITION_PID:
+      return bias_feedforward ? &write_joints<JointType, ControlMode::POSITION_PID, false, true> :
+        &write_joints<JointType, ControlMode::POSITION_PID>;
+    case ControlMode::VELOCITY:
+      return &write_joints<JointType, ControlMode::VELOCITY>;
+    case ControlMode::VELOCITY_PID:
+      return bias_feedforward ? &write_joints<JointType, ControlMode::VELOCITY_PID, false, true> :
+        &write_joints<JointType, ControlMode::VELOCITY_PID>;
+    case ControlMode::EFFORT:
+      return skip_unchanged ? &write_joints<JointType, ControlMode::EFFORT, true> :
+        &write_joints<JointType, ControlMode::EFFORT>;
+  }
+  return nullptr;
+}
+
+template <int JointType>
+MujocoSystem::JointKernel select_multi_dof_write_kernel(ControlMode mode, bool skip_unchanged)
+{
+  if (mode != ControlMode::EFFORT)
+  {
+    return nullptr;
   }
+  return skip_unchanged ? &write_joints<JointType, ControlMode::EFFORT, true> :
+    &write_joints<JointType, ControlMode::EFFORT>;
+}
 
-  // Add state interfaces for sensors
-  for (auto& sensor : ft_sensor_data_)
+// Returns nullptr for combinations which are not supported
+MujocoSystem::JointKernel select_write_kernel(int joint_type, ControlMode mode, bool skip_unchanged, bool bias_feedforward)
+{
+  switch (joint_type)
+  {
+    case mjJNT_FREE:
+      return select_multi_dof_write_kernel<mjJNT_FREE>(mode, skip_unchanged);
+    case mjJNT_BALL:
+      return select_multi_dof_write_kernel<mjJNT_BALL>(mode, skip_unchanged);
+    case mjJNT_SLIDE:
+      return select_scalar_write_kernel<mjJNT_SLIDE>(mode, skip_unchanged, bias_feedforward);
+    case mjJNT_HINGE:
+      return select_scalar_write_kernel<mjJNT_HINGE>(mode, skip_unchanged, bias_feedforward);
+    default:
+      return nullptr;
+  }
+}
+
+// Groups (kernel, joint index) pairs by kernel, preserving the order in which kernels first appear.
+// Runs without allocating once the output vectors have been reserved.
+void group_by_kernel(
+  const std::vector<std::pair<MujocoSystem::JointKernel, size_t>> & entries,
+  std::vector<size_t> & kernel_joints, std::vector<MujocoSystem::JointKernelRange> & kernels)
+{
+  kernel_joints.clear();
+  kernels.clear();
+  for (size_t i = 0; i < entries.size(); i++)
   {
-    if (auto it = sensors_hw_info_.find(sensor.name); it != sensors_hw_info_.end())
+    auto kernel = entries[i].first;
+    bool is_grouped = false;
+    for (const auto& range : kernels)
     {
-      for (const auto& state_if : it->second.state_interfaces)
+      is_grouped |= range.kernel == kernel;
+    }
+    if (is_grouped)
+    {
+      continue;
+    }
+
+    size_t begin = kernel_joints.size();
+    for (size_t j = i; j < entries.size(); j++)
+    {
+      if (entries[j].first == kernel)
       {
-        if (state_if.name == "force.x")
-        {
-          new_state_interfaces.emplace_back(sensor.name, state_if.name, &sensor.force.data.x());
-        }
-        else if (state_if.name == "force.y")
-        {
-          new_state_interfaces.emplace_back(sensor.name, state_if.name, &sensor.force.data.y());
-        }
-        else if (state_if.name == "force.z")
-        {
-          new_state_interfaces.emplace_back(sensor.name, state_if.name, &sensor.force.data.z());
-        }
-        else if (state_if.name == "torque.x")
-        {
-          new_state_interfaces.emplace_back(sensor.name, state_if.name, &sensor.torque.data.x());
-        }
-        else if (state_if.name == "torque.y")
-        {
-          new_state_interfaces.emplace_back(sensor.name, state_if.name, &sensor.torque.data.y());
-        }
-        else if (state_if.name == "torque.z")
-        {
-          new_state_interfaces.emplace_back(sensor.name, state_if.name, &sensor.torque.data.z());
-        }
+        kernel_joints.push_back(entries[j].second);
       }
     }
+    kernels.push_back({kernel, begin, kernel_joints.size()});
+  }
+}
+}  // namespace
+
+MujocoSystem::MujocoSystem()
+  : skip_unchanged_commands_(false), last_write_time_(0, 0, RCL_ROS_TIME), has_pending_switch_(false),
+    logger_(rclcpp::get_logger(""))
+{
+}
+
+std::vector<hardware_interface::StateInterface> MujocoSystem::export_state_interfaces()
+{
+  std::vector<hardware_interface::StateInterface> new_state_interfaces;
+  new_state_interfaces.reserve(state_interfaces_.size());
+
+  for (const auto& descriptor : state_interfaces_)
+  {
+    const auto& prefix = descriptor.type == InterfaceType::FORCE || descriptor.type == InterfaceType::TORQUE ?
+      ft_sensor_data_[descriptor.index].name : joint_states_[descriptor.index].name;
+    new_state_interfaces.emplace_back(prefix, get_interface_name(descriptor), get_state_source(descriptor));
   }
 
   return new_state_interfaces;
@@ -74,42 +393,166 @@ std::vector<hardware_interface::StateInterface> MujocoSystem::export_state_inter
 std::vector<hardware_interface::CommandInterface> MujocoSystem::export_command_interfaces()
 {
   std::vector<hardware_interface::CommandInterface> new_command_interfaces;
+  new_command_interfaces.reserve(command_interfaces_.size());
+
+  // controllers write into command_buffer_, latch_commands() hands the values over to write()
+  for (size_t i = 0; i < command_interfaces_.size(); i++)
+  {
+    const auto& descriptor = command_interfaces_[i];
+    const auto& prefix = descriptor.type == InterfaceType::WRENCH ? body_wrench_data_[descriptor.index].name :
+      joint_states_[descriptor.index].name;
+    new_command_interfaces.emplace_back(prefix, get_interface_name(descriptor), &command_buffer_[i]);
+  }
+
+  return new_command_interfaces;
+}
+
+hardware_interface::return_type MujocoSystem::prepare_command_mode_switch(
+  const std::vector<std::string> & start_interfaces,
+  const std::vector<std::string> & stop_interfaces)
+{
+  // requested position, velocity and effort control flags, indexed like joint_states_
+  std::vector<std::array<bool, 3>> modes(joint_states_.size());
+  for (size_t joint_index = 0; joint_index < joint_states_.size(); joint_index++)
+  {
+    const auto& joint_state = joint_states_[joint_index];
+    modes[joint_index] = {
+      joint_state.is_position_control_enabled, joint_state.is_velocity_control_enabled,
+      joint_state.is_effort_control_enabled};
+  }
+
+  for (const auto& interface_name : stop_interfaces)
+  {
+    if (auto it = command_interface_index_.find(interface_name); it != command_interface_index_.end())
+    {
+      modes[it->second.index][get_mode_index(it->second.type)] = false;
+    }
+  }
+
+  for (const auto& interface_name : start_interfaces)
+  {
+    if (auto it = command_interface_index_.find(interface_name); it != command_interface_index_.end())
+    {
+      modes[it->second.index][get_mode_index(it->second.type)] = true;
+    }
+  }
+
+  for (size_t joint_index = 0; joint_index < joint_states_.size(); joint_index++)
+  {
+    auto [position, velocity, effort] = modes[joint_index];
+    // Effort and PID modes all write qfrc_applied, so only one of them can be active at a time.
+    // Position and velocity without PID write qpos and qvel respectively and can be combined.
+    if ((effort && (position || velocity)) || (joint_states_[joint_index].is_pid_enabled && position && velocity))
+    {
+      RCLCPP_ERROR_STREAM(logger_, "Conflicting command interfaces requested for joint: " << joint_states_[joint_index].name);
+      return hardware_interface::return_type::ERROR;
+    }
+  }
+
+  return hardware_interface::return_type::OK;
+}
+
+hardware_interface::return_type MujocoSystem::perform_command_mode_switch(
+  const std::vector<std::string> & start_interfaces,
+  const std::vector<std::string> & stop_interfaces)
+{
+  // controllers may be updated while write() runs, so the switch is applied by latch_commands()
+  pending_start_interfaces_ = start_interfaces;
+  pending_stop_interfaces_ = stop_interfaces;
+  has_pending_switch_ = true;
+
+  return hardware_interface::return_type::OK;
+}
+
+void MujocoSystem::latch_commands()
+{
+  for (size_t i = 0; i < command_buffer_.size(); i++)
+  {
+    *command_targets_[i] = command_buffer_[i];
+  }
+
+  if (has_pending_switch_)
+  {
+    apply_command_mode_switch(pending_start_interfaces_, pending_stop_interfaces_);
+    has_pending_switch_ = false;
+  }
+}
+
+void MujocoSystem::apply_command_mode_switch(
+  const std::vector<std::string> & start_interfaces,
+  const std::vector<std::string> & stop_interfaces)
+{
+  for (const auto& interface_name : stop_interfaces)
+  {
+    if (auto it = command_interface_index_.find(interface_name); it != command_interface_index_.end())
+    {
+      get_control_flag(joint_states_[it->second.index], it->second.type) = false;
+    }
+    else if (auto it = body_wrench_interface_index_.find(interface_name); it != body_wrench_interface_index_.end())
+    {
+      // a released wrench must not keep pushing the body
+      *command_targets_[it->second] = 0.0;
+      command_buffer_[it->second] = 0.0;
+    }
+  }
 
-  // Joint command interfaces
-  for (auto& joint : joint_states_)
+  for (const auto& interface_name : start_interfaces)
   {
-    // Add command interfaces for joint hardware.
-    if (auto it = joint_hw_info_.find(joint.name); it != joint_hw_info_.end())
+    if (auto it = command_interface_index_.find(interface_name); it != command_interface_index_.end())
     {
-      for (const auto& command_if : it->second.command_interfaces)
+      auto& joint_state = joint_states_[it->second.index];
+      get_control_flag(joint_state, it->second.type) = true;
+      // the actuator picks up from the current state instead of its last command
+      if (int channel = joint_state.actuator_channels[get_mode_index(it->second.type)]; channel != -1)
       {
-        if (command_if.name.find(hardware_interface::HW_IF_POSITION) != std::string::npos)
-        {
-          new_command_interfaces.emplace_back(joint.name, hardware_interface::HW_IF_POSITION, &joint.position_command);
-        }
-        else if (command_if.name.find(hardware_interface::HW_IF_VELOCITY) != std::string::npos)
-        {
-          new_command_interfaces.emplace_back(joint.name, hardware_interface::HW_IF_VELOCITY, &joint.velocity_command);
-        }
-        else if (command_if.name == hardware_interface::HW_IF_EFFORT)
-        {
-          new_command_interfaces.emplace_back(joint.name, hardware_interface::HW_IF_EFFORT, &joint.effort_command);
-        }
+        double value = it->second.type == InterfaceType::POSITION ? mj_data_->qpos[joint_state.mj_pos_adr] :
+          it->second.type == InterfaceType::VELOCITY ? mj_data_->qvel[joint_state.mj_vel_adr] :
+          mj_data_->qfrc_applied[joint_state.mj_vel_adr];
+        actuator_dynamics_.reset(channel, value);
+      }
+      if (it->second.type == InterfaceType::POSITION)
+      {
+        joint_state.position_pid.reset();
+      }
+      else if (it->second.type == InterfaceType::VELOCITY)
+      {
+        joint_state.velocity_pid.reset();
       }
     }
   }
 
-  return new_command_interfaces;
+  for (auto& joint_state : joint_states_)
+  {
+    // mimic joints follow the control mode of the joint they mimic
+    if (joint_state.is_mimic)
+    {
+      const auto& mimicked_joint_state = joint_states_.at(joint_state.mimicked_joint_index);
+      joint_state.is_position_control_enabled =
+        joint_state.has_position_command_interface && mimicked_joint_state.is_position_control_enabled;
+      joint_state.is_velocity_control_enabled =
+        joint_state.has_velocity_command_interface && mimicked_joint_state.is_velocity_control_enabled;
+      joint_state.is_effort_control_enabled =
+        joint_state.has_effort_command_interface && mimicked_joint_state.is_effort_control_enabled;
+    }
+
+    // qfrc_applied is persistent in mjData, so clear it once nothing drives it anymore
+    bool writes_qfrc_applied = joint_state.is_effort_control_enabled ||
+      (joint_state.is_pid_enabled && (joint_state.is_position_control_enabled || joint_state.is_velocity_control_enabled));
+    if (!writes_qfrc_applied && joint_state.mj_joint_type >= 0)
+    {
+      std::fill_n(mj_data_->qfrc_applied + joint_state.mj_vel_adr, get_dof_count(joint_state.mj_joint_type), 0.0);
+    }
+  }
+
+  build_joint_kernels();
 }
 
-hardware_interface::return_type MujocoSystem::read(const rclcpp::Time & /* time */, const rclcpp::Duration & /* period */)
+hardware_interface::return_type MujocoSystem::read(const rclcpp::Time & time, const rclcpp::Duration & period)
 {
   // Joint states
-  for (auto& joint_state : joint_states_)
+  for (const auto& range : read_kernels_)
   {
-    joint_state.position = mj_data_->qpos[joint_state.mj_pos_adr];
-    joint_state.velocity = mj_data_->qvel[joint_state.mj_vel_adr];
-    joint_state.effort = mj_data_->qfrc_applied[joint_state.mj_vel_adr];
+    range.kernel(joint_states_, read_kernel_joints_.data() + range.begin, read_kernel_joints_.data() + range.end, mj_data_, 0);
   }
 
   // IMU Sensor data
@@ -130,11 +573,32 @@ hardware_interface::return_type MujocoSystem::read(const rclcpp::Time & /* time
     data.torque.data.z() = -mj_data_->sensordata[data.torque.mj_sensor_index + 2];
   }
 
+  // the exported values have just been refreshed with the simulated ones
+  if (!sensor_emulator_.empty())
+  {
+    sensor_emulator_.apply(time.seconds(), period.seconds());
+  }
+
   return hardware_interface::return_type::OK;
 }
 
-hardware_interface::return_type MujocoSystem::write(const rclcpp::Time & /* time */, const rclcpp::Duration & period)
+hardware_interface::return_type MujocoSystem::write(const rclcpp::Time & time, const rclcpp::Duration & period)
 {
+  // the simulation has been reset, qfrc_applied no longer holds the applied commands and the
+  // actuators start over
+  if (time < last_write_time_)
+  {
+    if (skip_unchanged_commands_)
+    {
+      reset_applied_commands();
+    }
+    actuator_dynamics_.reset();
+  }
+  last_write_time_ = time;
+
+  // write() runs once per step, while period is the time since the last controller update
+  actuator_dynamics_.apply();
+
   // update mimic joint
   for (auto& joint_state : joint_states_)
   {
@@ -146,52 +610,24 @@ hardware_interface::return_type MujocoSystem::write(const rclcpp::Time & /* time
     }
   }
   // Joint states
-  for (auto& joint_state : joint_states_)
+  for (const auto& range : write_kernels_)
   {
-    if (joint_state.is_position_control_enabled)
-    {
-      if (joint_state.is_pid_enabled)
-      {
-        double error = joint_state.position_command - mj_data_->qpos[joint_state.mj_pos_adr];
-        mj_data_->qfrc_applied[joint_state.mj_vel_adr] = joint_state.position_pid.computeCommand(error, period.nanoseconds());
-      }
-      else
-      {
-        mj_data_->qpos[joint_state.mj_pos_adr] = joint_state.position_command;
-      }
-    }
-
-    if (joint_state.is_velocity_control_enabled)
-    {
-      if (joint_state.is_pid_enabled)
-      {
-        double error = joint_state.velocity_command - mj_data_->qvel[joint_state.mj_vel_adr];
-        mj_data_->qfrc_applied[joint_state.mj_vel_adr] = joint_state.velocity_pid.computeCommand(error, period.nanoseconds());;
-      }
-      else
-      {
-        mj_data_->qvel[joint_state.mj_vel_adr] = joint_state.velocity_command;
-      }
-    }
-
-    if (joint_state.is_effort_control_enabled)
-    {
-      double min_eff, max_eff;
-      min_eff = joint_state.joint_limits.has_effort_limits ? -1*joint_state.joint_limits.max_effort : std::numeric_limits<double>::lowest();
-      min_eff = std::max(min_eff, joint_state.min_effort_command);
-
-      max_eff = joint_state.joint_limits.has_effort_limits ? joint_state.joint_limits.max_effort : std::numeric_limits<double>::max();
-      max_eff = std::min(max_eff, joint_state.max_effort_command);
+    range.kernel(joint_states_, write_kernel_joints_.data() + range.begin, write_kernel_joints_.data() + range.end, mj_data_,
+      static_cast<uint64_t>(period.nanoseconds()));
+  }
 
-      mj_data_->qfrc_applied[joint_state.mj_vel_adr] = clamp(joint_state.effort_command, min_eff, max_eff);
-    }
+  // External wrenches, xfrc_applied is cleared before every step
+  for (const auto& body : body_wrench_data_)
+  {
+    mju_addTo(mj_data_->xfrc_applied + 6 * body.mj_body_id, body.commands.data(), 6);
   }
 
   return hardware_interface::return_type::OK;
 }
 
 bool MujocoSystem::init_sim(rclcpp::Node::SharedPtr& node, mjModel* mujoco_model, mjData *mujoco_data,
-  const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info)
+  const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info,
+  const MujocoNameIndex & name_index)
 {
   node_ = node;
   mj_model_ = mujoco_model;
@@ -199,30 +635,183 @@ bool MujocoSystem::init_sim(rclcpp::Node::SharedPtr& node, mjModel* mujoco_model
 
   logger_ = rclcpp::get_logger(node_->get_name() + std::string("mujoco_system"));
 
-  register_joints(urdf_model, hardware_info);
-  register_sensors(urdf_model, hardware_info);
+  auto skip_unchanged_commands = hardware_info.hardware_parameters.find("skip_unchanged_commands");
+  skip_unchanged_commands_ = skip_unchanged_commands != hardware_info.hardware_parameters.end() &&
+    skip_unchanged_commands->second == "true";
+
+  register_joints(urdf_model, hardware_info, name_index);
+  register_sensors(urdf_model, hardware_info, name_index);
+  register_body_wrenches(hardware_info, name_index);
+  register_sensor_models(hardware_info);
 
   set_initial_pose();
+
+  register_actuator_models(hardware_info);
+
+  // the buffers start with the commands set up while registering, e.g. initial positions.
+  // Scalar joint commands go to their actuator, which writes the joint commands in write().
+  for (const auto& descriptor : command_interfaces_)
+  {
+    double* target = get_command_target(descriptor);
+    int channel = descriptor.type == InterfaceType::WRENCH ? -1 :
+      joint_states_[descriptor.index].actuator_channels[get_mode_index(descriptor.type)];
+    if (channel != -1)
+    {
+      target = actuator_dynamics_.get_input(channel);
+    }
+    command_targets_.push_back(target);
+    command_buffer_.push_back(*target);
+  }
+
+  // enough room for a read kernel and up to three write kernels per joint, so that rebuilding
+  // the kernel tables on a command mode switch does not allocate
+  kernel_entries_.reserve(3 * joint_states_.size());
+  read_kernel_joints_.reserve(joint_states_.size());
+  read_kernels_.reserve(joint_states_.size());
+  write_kernel_joints_.reserve(3 * joint_states_.size());
+  write_kernels_.reserve(3 * joint_states_.size());
+  build_joint_kernels();
+  return true;
+}
+
+bool MujocoSystem::check_model(const mjModel* mujoco_model, const MujocoNameIndex & name_index, std::string & error) const
+{
+  // the delay lines and lag factors of the sensor and actuator models are computed for the timestep
+  if (mujoco_model->opt.timestep != mj_model_->opt.timestep)
+  {
+    error = "The timestep has changed from " + std::to_string(mj_model_->opt.timestep) + " to " +
+      std::to_string(mujoco_model->opt.timestep);
+    return false;
+  }
+
+  for (const auto& joint_state : joint_states_)
+  {
+    // joints which were not found in the previous model are not simulated either
+    if (joint_state.mj_joint_type < 0)
+    {
+      continue;
+    }
+    int mujoco_joint_id = name_index.get_id(mjtObj::mjOBJ_JOINT, joint_state.name);
+    if (mujoco_joint_id == -1)
+    {
+      error = "Failed to find joint in mujoco model, joint name: " + joint_state.name;
+      return false;
+    }
+    if (mujoco_model->jnt_type[mujoco_joint_id] != joint_state.mj_joint_type)
+    {
+      error = "The type of the joint has changed, joint name: " + joint_state.name;
+      return false;
+    }
+  }
+
+  for (const auto& sensor_data : ft_sensor_data_)
+  {
+    if (!sensor_data.name.empty() && (name_index.get_id(mjtObj::mjOBJ_SENSOR, sensor_data.force.name) == -1 ||
+      name_index.get_id(mjtObj::mjOBJ_SENSOR, sensor_data.torque.name) == -1))
+    {
+      error = "Failed to find sensor in mujoco model, sensor name: " + sensor_data.name;
+      return false;
+    }
+  }
+
+  for (const auto& body_data : body_wrench_data_)
+  {
+    if (name_index.get_id(mjtObj::mjOBJ_BODY, body_data.name) == -1)
+    {
+      error = "Failed to find body in mujoco model, body name: " + body_data.name;
+      return false;
+    }
+  }
   return true;
 }
 
-void MujocoSystem::register_joints(const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info)
+void MujocoSystem::reload_sim(mjModel* mujoco_model, mjData* mujoco_data, const MujocoNameIndex & name_index)
+{
+  // the joints continue from their state in the previous model, so that controllers do not jump
+  for (auto& joint_state : joint_states_)
+  {
+    if (joint_state.mj_joint_type < 0)
+    {
+      continue;
+    }
+    int mujoco_joint_id = name_index.get_id(mjtObj::mjOBJ_JOINT, joint_state.name);
+    int pos_adr = mujoco_model->jnt_qposadr[mujoco_joint_id];
+    int vel_adr = mujoco_model->jnt_dofadr[mujoco_joint_id];
+    int dof_count = get_dof_count(joint_state.mj_joint_type);
+    int pos_count = joint_state.mj_joint_type == mjJNT_FREE ? JointDimensions<mjJNT_FREE>::nq :
+      joint_state.mj_joint_type == mjJNT_BALL ? JointDimensions<mjJNT_BALL>::nq : 1;
+    mju_copy(mujoco_data->qpos + pos_adr, mj_data_->qpos + joint_state.mj_pos_adr, pos_count);
+    mju_copy(mujoco_data->qvel + vel_adr, mj_data_->qvel + joint_state.mj_vel_adr, dof_count);
+    mju_copy(mujoco_data->qfrc_applied + vel_adr, mj_data_->qfrc_applied + joint_state.mj_vel_adr, dof_count);
+    joint_state.mj_pos_adr = pos_adr;
+    joint_state.mj_vel_adr = vel_adr;
+  }
+
+  for (auto& sensor_data : ft_sensor_data_)
+  {
+    if (sensor_data.name.empty())
+    {
+      continue;
+    }
+    sensor_data.force.mj_sensor_index =
+      mujoco_model->sensor_adr[name_index.get_id(mjtObj::mjOBJ_SENSOR, sensor_data.force.name)];
+    sensor_data.torque.mj_sensor_index =
+      mujoco_model->sensor_adr[name_index.get_id(mjtObj::mjOBJ_SENSOR, sensor_data.torque.name)];
+  }
+
+  for (auto& body_data : body_wrench_data_)
+  {
+    body_data.mj_body_id = name_index.get_id(mjtObj::mjOBJ_BODY, body_data.name);
+  }
+
+  mj_model_ = mujoco_model;
+  mj_data_ = mujoco_data;
+  reset_applied_commands();
+}
+
+std::vector<MujocoSystemInterface::EffortInput> MujocoSystem::get_effort_inputs() const
+{
+  std::vector<EffortInput> inputs;
+  for (const auto& descriptor : command_interfaces_)
+  {
+    if (descriptor.type != InterfaceType::EFFORT && descriptor.type != InterfaceType::EFFORT_COMPONENT)
+    {
+      continue;
+    }
+    const auto& joint_state = joint_states_[descriptor.index];
+    if (joint_state.mj_vel_adr < 0)
+    {
+      continue;
+    }
+    inputs.push_back(
+      {joint_state.name + "/" + get_interface_name(descriptor), joint_state.mj_vel_adr + descriptor.component});
+  }
+  return inputs;
+}
+
+void MujocoSystem::register_joints(const urdf::Model& urdf_model, const hardware_interface::HardwareInfo & hardware_info,
+  const MujocoNameIndex & name_index)
 {
   joint_states_.resize(hardware_info.joints.size());
 
+  // index of each joint of this component, to resolve mimicked joints
+  std::unordered_map<std::string, size_t> joint_indices;
+  joint_indices.reserve(hardware_info.joints.size());
   for (size_t joint_index = 0; joint_index < hardware_info.joints.size(); joint_index++)
   {
-    auto joint = hardware_info.joints.at(joint_index);
-    int mujoco_joint_id = mj_name2id(mj_model_, mjtObj::mjOBJ_JOINT, joint.name.c_str());
+    joint_indices.emplace(hardware_info.joints[joint_index].name, joint_index);
+  }
+
+  for (size_t joint_index = 0; joint_index < hardware_info.joints.size(); joint_index++)
+  {
+    const auto& joint = hardware_info.joints.at(joint_index);
+    int mujoco_joint_id = name_index.get_id(mjtObj::mjOBJ_JOINT, joint.name);
     if (mujoco_joint_id == -1)
     {
       RCLCPP_ERROR_STREAM(logger_, "Failed to find joint in mujoco model, joint name: " << joint.name);
       continue;
     }
 
-    // Add to the joint hw information map
-    joint_hw_info_.insert(std::make_pair(joint.name, joint));
-
     // save information in joint_states_ variable
     JointState joint_state;
     joint_state.name = joint.name;
@@ -239,18 +828,13 @@ void MujocoSystem::register_joints(const urdf::Model& urdf_model, const hardware
     // check if mimicked
     if (joint.parameters.find("mimic") != joint.parameters.end()) {
       const auto mimicked_joint = joint.parameters.at("mimic");
-      const auto mimicked_joint_it = std::find_if(
-        hardware_info.joints.begin(), hardware_info.joints.end(),
-        [&mimicked_joint](const hardware_interface::ComponentInfo & info) {
-          return info.name == mimicked_joint;
-        });
-      if (mimicked_joint_it == hardware_info.joints.end()) {
+      const auto mimicked_joint_it = joint_indices.find(mimicked_joint);
+      if (mimicked_joint_it == joint_indices.end()) {
         throw std::runtime_error(
                 std::string("Mimicked joint '") + mimicked_joint + "' not found");
       }
       last_joint_state.is_mimic = true;
-      last_joint_state.mimicked_joint_index = std::distance(
-        hardware_info.joints.begin(), mimicked_joint_it);
+      last_joint_state.mimicked_joint_index = mimicked_joint_it->second;
 
       auto param_it = joint.parameters.find("multiplier");
       if (param_it != joint.parameters.end()) {
@@ -275,23 +859,53 @@ void MujocoSystem::register_joints(const urdf::Model& urdf_model, const hardware
       }
     };
 
-    // Set initial values
+    // Resolve state interfaces and set initial values
+    auto add_state_interface = [this, joint_index](InterfaceType type, int component)
+    {
+      state_interfaces_.push_back({static_cast<uint32_t>(joint_index), type, static_cast<uint8_t>(component)});
+    };
+
     for (const auto& state_if : joint.state_interfaces)
     {
-      if (state_if.name == hardware_interface::HW_IF_POSITION)
+      if (is_multi_dof(last_joint_state.mj_joint_type))
+      {
+        if (int i = find_position_component(last_joint_state.mj_joint_type, state_if.name); i != -1)
+        {
+          add_state_interface(InterfaceType::POSITION_COMPONENT, i);
+        }
+        else if (int i = find_velocity_component(last_joint_state.mj_joint_type, state_if.name); i != -1)
+        {
+          add_state_interface(InterfaceType::VELOCITY_COMPONENT, i);
+        }
+        else if (int i = find_effort_component(last_joint_state.mj_joint_type, state_if.name); i != -1)
+        {
+          add_state_interface(InterfaceType::EFFORT_COMPONENT, i);
+        }
+      }
+      else if (state_if.name == hardware_interface::HW_IF_POSITION)
       {
         last_joint_state.position = get_initial_value(state_if);
+        add_state_interface(InterfaceType::POSITION, 0);
       }
       else if (state_if.name == hardware_interface::HW_IF_VELOCITY)
       {
         last_joint_state.velocity = get_initial_value(state_if);
+        add_state_interface(InterfaceType::VELOCITY, 0);
       }
       else if (state_if.name == hardware_interface::HW_IF_EFFORT)
       {
         last_joint_state.effort = get_initial_value(state_if);
+        add_state_interface(InterfaceType::EFFORT, 0);
       }
     }
 
+    auto add_command_interface = [this, joint_index, &joint](InterfaceType type, int component)
+    {
+      InterfaceDescriptor descriptor {static_cast<uint32_t>(joint_index), type, static_cast<uint8_t>(component)};
+      command_interfaces_.push_back(descriptor);
+      command_interface_index_.emplace(joint.name + "/" + get_interface_name(descriptor), descriptor);
+    };
+
     auto get_min_value = [this](const hardware_interface::InterfaceInfo & interface_info)
     {
       if (!interface_info.min.empty())
@@ -322,25 +936,43 @@ void MujocoSystem::register_joints(const urdf::Model& urdf_model, const hardware
     // overwrite joint limit with min/max value
     for (const auto& command_if : joint.command_interfaces)
     {
+      if (is_multi_dof(last_joint_state.mj_joint_type))
+      {
+        // ball and free joints are driven by one effort interface per force/torque component
+        if (int i = find_effort_component(last_joint_state.mj_joint_type, command_if.name); i != -1)
+        {
+          add_command_interface(InterfaceType::EFFORT_COMPONENT, i);
+          last_joint_state.has_effort_command_interface = true;
+          last_joint_state.min_effort_command = get_min_value(command_if);
+          last_joint_state.max_effort_command = get_max_value(command_if);
+        }
+        else
+        {
+          RCLCPP_ERROR_STREAM(logger_, "Unsupported command interface '" << command_if.name << "' for ball/free joint: " << joint.name);
+        }
+        continue;
+      }
+
       if (command_if.name.find(hardware_interface::HW_IF_POSITION) != std::string::npos)
       {
-        last_joint_state.is_position_control_enabled = true;
+        add_command_interface(InterfaceType::POSITION, 0);
+        last_joint_state.has_position_command_interface = true;
         last_joint_state.position_command = last_joint_state.position;
-        // TODO: These are not used at all. Potentially can be removed.
         last_joint_state.min_position_command = get_min_value(command_if);
         last_joint_state.max_position_command = get_max_value(command_if);
       }
       else if (command_if.name.find(hardware_interface::HW_IF_VELOCITY) != std::string::npos)
       {
-        last_joint_state.is_velocity_control_enabled = true;
+        add_command_interface(InterfaceType::VELOCITY, 0);
+        last_joint_state.has_velocity_command_interface = true;
         last_joint_state.velocity_command = last_joint_state.velocity;
-        // TODO: These are not used at all. Potentially can be removed.
         last_joint_state.min_velocity_command = get_min_value(command_if);
         last_joint_state.max_velocity_command = get_max_value(command_if);
       }
       else if (command_if.name == hardware_interface::HW_IF_EFFORT)
       {
-        last_joint_state.is_effort_control_enabled = true;
+        add_command_interface(InterfaceType::EFFORT, 0);
+        last_joint_state.has_effort_command_interface = true;
         last_joint_state.effort_command = last_joint_state.effort;
         last_joint_state.min_effort_command = get_min_value(command_if);
         last_joint_state.max_effort_command = get_max_value(command_if);
@@ -352,34 +984,45 @@ void MujocoSystem::register_joints(const urdf::Model& urdf_model, const hardware
       }
     }
 
+    // A joint with a single command interface is driven by it from the start, as before.
+    // Joints with several command interfaces wait until a controller claims one of them.
+    if (last_joint_state.has_position_command_interface + last_joint_state.has_velocity_command_interface +
+      last_joint_state.has_effort_command_interface == 1)
+    {
+      last_joint_state.is_position_control_enabled = last_joint_state.has_position_command_interface;
+      last_joint_state.is_velocity_control_enabled = last_joint_state.has_velocity_command_interface;
+      last_joint_state.is_effort_control_enabled = last_joint_state.has_effort_command_interface;
+    }
+
     // Get PID gains, if needed
     if (last_joint_state.is_pid_enabled)
     {
       last_joint_state.position_pid = get_pid_gains(joint, hardware_interface::HW_IF_POSITION);
       last_joint_state.velocity_pid = get_pid_gains(joint, hardware_interface::HW_IF_VELOCITY);
+      auto bias_feedforward = joint.parameters.find(PARAM_BIAS_FEEDFORWARD);
+      last_joint_state.has_bias_feedforward = bias_feedforward != joint.parameters.end() &&
+        bias_feedforward->second == "true";
     }
   }
 }
 
-void MujocoSystem::register_sensors(const urdf::Model& /* urdf_model */, const hardware_interface::HardwareInfo & hardware_info)
+void MujocoSystem::register_sensors(const urdf::Model& /* urdf_model */, const hardware_interface::HardwareInfo & hardware_info,
+  const MujocoNameIndex & name_index)
 {
   // TODO: for now, assuming all sensors are ft_sensor
   ft_sensor_data_.resize(hardware_info.sensors.size());
 
   for (size_t sensor_index = 0; sensor_index < hardware_info.sensors.size(); sensor_index++)
   {
-    auto sensor = hardware_info.sensors.at(sensor_index);
-
-    // Add to the sensor hw information map
-    sensors_hw_info_.insert(std::make_pair(sensor.name, sensor));
+    const auto& sensor = hardware_info.sensors.at(sensor_index);
 
     FTSensorData sensor_data;
     sensor_data.name = sensor.name;
     sensor_data.force.name = sensor.name + "_force";
     sensor_data.torque.name = sensor.name + "_torque";
 
-    int force_sensor_id = mj_name2id(mj_model_, mjtObj::mjOBJ_SENSOR, sensor_data.force.name.c_str());
-    int torque_sensor_id = mj_name2id(mj_model_, mjtObj::mjOBJ_SENSOR, sensor_data.torque.name.c_str());
+    int force_sensor_id = name_index.get_id(mjtObj::mjOBJ_SENSOR, sensor_data.force.name);
+    int torque_sensor_id = name_index.get_id(mjtObj::mjOBJ_SENSOR, sensor_data.torque.name);
 
     if (force_sensor_id == -1 || torque_sensor_id == -1)
     {
@@ -391,6 +1034,48 @@ void MujocoSystem::register_sensors(const urdf::Model& /* urdf_model */, const h
     sensor_data.torque.mj_sensor_index = mj_model_->sensor_adr[torque_sensor_id];
 
     ft_sensor_data_.at(sensor_index) = sensor_data;
+
+    for (const auto& state_if : sensor.state_interfaces)
+    {
+      if (int i = find_component(FREE_EFFORT_NAMES, state_if.name); i != -1)
+      {
+        state_interfaces_.push_back({
+          static_cast<uint32_t>(sensor_index), i < 3 ? InterfaceType::FORCE : InterfaceType::TORQUE,
+          static_cast<uint8_t>(i % 3)});
+      }
+    }
+  }
+}
+
+void MujocoSystem::register_body_wrenches(const hardware_interface::HardwareInfo & hardware_info,
+  const MujocoNameIndex & name_index)
+{
+  // GPIOs named after a body take external wrench commands, e.g. "base/force.x"
+  for (const auto& gpio : hardware_info.gpios)
+  {
+    BodyWrenchData body_data;
+    body_data.name = gpio.name;
+    body_data.mj_body_id = name_index.get_id(mjtObj::mjOBJ_BODY, gpio.name);
+    if (body_data.mj_body_id == -1)
+    {
+      RCLCPP_ERROR_STREAM(logger_, "Failed to find body in mujoco model, body name: " << gpio.name);
+      continue;
+    }
+
+    auto body_index = static_cast<uint32_t>(body_wrench_data_.size());
+    body_wrench_data_.push_back(body_data);
+    for (const auto& command_if : gpio.command_interfaces)
+    {
+      int i = find_component(FREE_EFFORT_NAMES, command_if.name);
+      if (i == -1)
+      {
+        RCLCPP_ERROR_STREAM(logger_, "Unsupported wrench command interface: " << gpio.name << "/" << command_if.name);
+        continue;
+      }
+      InterfaceDescriptor descriptor {body_index, InterfaceType::WRENCH, static_cast<uint8_t>(i)};
+      body_wrench_interface_index_.emplace(gpio.name + "/" + command_if.name, command_interfaces_.size());
+      command_interfaces_.push_back(descriptor);
+    }
   }
 }
 
@@ -398,10 +1083,190 @@ void MujocoSystem::set_initial_pose()
 {
   for (auto& joint_state : joint_states_)
   {
+    // the initial pose of ball and free joints is taken from the model
+    if (joint_state.mj_joint_type < 0 || is_multi_dof(joint_state.mj_joint_type))
+    {
+      continue;
+    }
     mj_data_->qpos[joint_state.mj_pos_adr] = joint_state.position;
   }
 }
 
+void MujocoSystem::build_joint_kernels()
+{
+  kernel_entries_.clear();
+  for (size_t joint_index = 0; joint_index < joint_states_.size(); joint_index++)
+  {
+    if (auto kernel = select_read_kernel(joint_states_[joint_index].mj_joint_type))
+    {
+      kernel_entries_.emplace_back(kernel, joint_index);
+    }
+  }
+  group_by_kernel(kernel_entries_, read_kernel_joints_, read_kernels_);
+
+  // position, velocity and effort kernels run in this order, as they did per joint before
+  kernel_entries_.clear();
+  for (auto mode : {ControlMode::POSITION, ControlMode::VELOCITY, ControlMode::EFFORT})
+  {
+    for (size_t joint_index = 0; joint_index < joint_states_.size(); joint_index++)
+    {
+      const auto& joint_state = joint_states_[joint_index];
+      bool is_enabled = mode == ControlMode::POSITION ? joint_state.is_position_control_enabled :
+        mode == ControlMode::VELOCITY ? joint_state.is_velocity_control_enabled : joint_state.is_effort_control_enabled;
+      if (!is_enabled)
+      {
+        continue;
+      }
+
+      auto joint_mode = mode;
+      if (joint_state.is_pid_enabled && mode == ControlMode::POSITION)
+      {
+        joint_mode = ControlMode::POSITION_PID;
+      }
+      else if (joint_state.is_pid_enabled && mode == ControlMode::VELOCITY)
+      {
+        joint_mode = ControlMode::VELOCITY_PID;
+      }
+
+      if (auto kernel = select_write_kernel(joint_state.mj_joint_type, joint_mode, skip_unchanged_commands_,
+        joint_state.has_bias_feedforward))
+      {
+        kernel_entries_.emplace_back(kernel, joint_index);
+      }
+    }
+  }
+  group_by_kernel(kernel_entries_, write_kernel_joints_, write_kernels_);
+  reset_applied_commands();
+}
+
+void MujocoSystem::reset_applied_commands()
+{
+  // NaN never compares equal, so the next write applies every command
+  for (auto& joint_state : joint_states_)
+  {
+    joint_state.applied_effort_commands.fill(std::numeric_limits<double>::quiet_NaN());
+  }
+}
+
+double* MujocoSystem::get_command_target(const InterfaceDescriptor & descriptor)
+{
+  if (descriptor.type == InterfaceType::WRENCH)
+  {
+    return &body_wrench_data_[descriptor.index].commands[descriptor.component];
+  }
+
+  auto& joint = joint_states_[descriptor.index];
+  switch (descriptor.type)
+  {
+    case InterfaceType::POSITION:
+      return &joint.position_command;
+    case InterfaceType::VELOCITY:
+      return &joint.velocity_command;
+    case InterfaceType::EFFORT:
+      return &joint.effort_command;
+    default:
+      return &joint.effort_commands[descriptor.component];
+  }
+}
+
+double* MujocoSystem::get_state_source(const InterfaceDescriptor & descriptor)
+{
+  if (descriptor.type == InterfaceType::FORCE || descriptor.type == InterfaceType::TORQUE)
+  {
+    auto& sensor = ft_sensor_data_[descriptor.index];
+    return descriptor.type == InterfaceType::FORCE ? &sensor.force.data[descriptor.component] :
+      &sensor.torque.data[descriptor.component];
+  }
+
+  auto& joint = joint_states_[descriptor.index];
+  switch (descriptor.type)
+  {
+    case InterfaceType::POSITION:
+      return &joint.position;
+    case InterfaceType::VELOCITY:
+      return &joint.velocity;
+    case InterfaceType::EFFORT:
+      return &joint.effort;
+    case InterfaceType::POSITION_COMPONENT:
+      return &joint.positions[descriptor.component];
+    case InterfaceType::VELOCITY_COMPONENT:
+      return &joint.velocities[descriptor.component];
+    default:
+      return &joint.efforts[descriptor.component];
+  }
+}
+
+void MujocoSystem::register_actuator_models(const hardware_interface::HardwareInfo & hardware_info)
+{
+  for (const auto& descriptor : command_interfaces_)
+  {
+    // mimic joints follow the output of the joint they mimic, ball and free joints are not modeled
+    auto& joint_state = joint_states_[descriptor.index];
+    if (descriptor.type == InterfaceType::WRENCH || descriptor.type == InterfaceType::EFFORT_COMPONENT ||
+      joint_state.is_mimic)
+    {
+      continue;
+    }
+
+    auto mode = get_mode_index(descriptor.type);
+    auto [min, max] = mode == 0 ? get_position_bounds(joint_state) :
+      mode == 1 ? get_velocity_bounds(joint_state) : get_effort_bounds(joint_state);
+    auto model = ActuatorModel::from_parameters(
+      hardware_info.joints[descriptor.index].parameters, SCALAR_NAMES[mode] + "_command");
+    joint_state.actuator_channels[mode] = static_cast<int>(
+      actuator_dynamics_.add(get_command_target(descriptor), model, min, max, mj_model_->opt.timestep));
+  }
+}
+
+void MujocoSystem::register_sensor_models(const hardware_interface::HardwareInfo & hardware_info)
+{
+  for (const auto& descriptor : state_interfaces_)
+  {
+    bool is_sensor = descriptor.type == InterfaceType::FORCE || descriptor.type == InterfaceType::TORQUE;
+    const auto& parameters = is_sensor ? hardware_info.sensors[descriptor.index].parameters :
+      hardware_info.joints[descriptor.index].parameters;
+    const auto& name = get_interface_name(descriptor);
+    auto model = SensorModel::from_parameters(parameters, name);
+    // components share the parameters of their vector, e.g. force_noise_stddev for force.x
+    auto separator = name.find('.');
+    if (!model.is_enabled() && separator != std::string::npos)
+    {
+      model = SensorModel::from_parameters(parameters, name.substr(0, separator));
+    }
+    if (model.is_enabled())
+    {
+      sensor_emulator_.add(get_state_source(descriptor), model, mj_model_->opt.timestep);
+    }
+  }
+
+  auto seed = hardware_info.hardware_parameters.find("sensor_seed");
+  sensor_emulator_.reset(seed != hardware_info.hardware_parameters.end() ? std::stoull(seed->second) : 0);
+}
+
+const std::string & MujocoSystem::get_interface_name(const InterfaceDescriptor & descriptor) const
+{
+  switch (descriptor.type)
+  {
+    case InterfaceType::POSITION_COMPONENT:
+      return joint_states_[descriptor.index].mj_joint_type == mjJNT_BALL ? BALL_POSITION_NAMES[descriptor.component] :
+        FREE_POSITION_NAMES[descriptor.component];
+    case InterfaceType::VELOCITY_COMPONENT:
+      return joint_states_[descriptor.index].mj_joint_type == mjJNT_BALL ? BALL_VELOCITY_NAMES[descriptor.component] :
+        FREE_VELOCITY_NAMES[descriptor.component];
+    case InterfaceType::EFFORT_COMPONENT:
+      return joint_states_[descriptor.index].mj_joint_type == mjJNT_BALL ? BALL_EFFORT_NAMES[descriptor.component] :
+        FREE_EFFORT_NAMES[descriptor.component];
+    case InterfaceType::FORCE:
+      return FREE_EFFORT_NAMES[descriptor.component];
+    case InterfaceType::TORQUE:
+      return FREE_EFFORT_NAMES[3 + descriptor.component];
+    case InterfaceType::WRENCH:
+      return FREE_EFFORT_NAMES[descriptor.component];
+    default:
+      return SCALAR_NAMES[get_mode_index(descriptor.type)];
+  }
+}
+
 void MujocoSystem::get_joint_limits(urdf::JointConstSharedPtr urdf_joint, joint_limits::JointLimits& joint_limits)
 {
   if (urdf_joint->limits)
@@ -410,6 +1275,11 @@ void MujocoSystem::get_joint_limits(urdf::JointConstSharedPtr urdf_joint, joint_
     joint_limits.max_position = urdf_joint->limits->upper;
     joint_limits.max_velocity = urdf_joint->limits->velocity;
     joint_limits.max_effort = urdf_joint->limits->effort;
+    // continuous joints have no position limits, zero velocity and effort limits mean unlimited
+    joint_limits.has_position_limits =
+      urdf_joint->type == urdf::Joint::REVOLUTE || urdf_joint->type == urdf::Joint::PRISMATIC;
+    joint_limits.has_velocity_limits = joint_limits.max_velocity > 0.0;
+    joint_limits.has_effort_limits = joint_limits.max_effort > 0.0;
   }
 }
 
@@ -0,0 +1,128 @@
+#include "mujoco_ros2_control/mujoco_tracer.hpp"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+namespace mujoco_ros2_control
+{
+namespace
+{
+std::atomic<uint64_t> next_tracer_id {1};
+
+// ring of the calling thread, tracers are told apart by their id since addresses may be reused
+struct ThreadRing
+{
+  uint64_t tracer_id {0};
+  void* ring {nullptr};
+};
+thread_local ThreadRing thread_ring;
+}  // namespace
+
+MujocoTracer::MujocoTracer(size_t events_per_thread)
+  : id_(next_tracer_id.fetch_add(1)), events_per_thread_(std::max<size_t>(events_per_thread, 1)),
+    start_(std::chrono::steady_clock::now())
+{
+}
+
+int64_t MujocoTracer::now() const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+}
+
+void MujocoTracer::record(const char* name, int64_t start, int64_t end)
+{
+  Ring* ring = get_ring();
+  uint64_t index = ring->count.load(std::memory_order_relaxed);
+  // orders the previous count before the slot, so that dump() sees the count of any event it read
+  std::atomic_thread_fence(std::memory_order_release);
+  auto& event = ring->events[index % ring->capacity];
+  event.name.store(name, std::memory_order_relaxed);
+  event.start.store(start, std::memory_order_relaxed);
+  event.duration.store(end - start, std::memory_order_relaxed);
+  ring->count.store(index + 1, std::memory_order_release);
+}
+
+void MujocoTracer::set_thread_name(const std::string & name)
+{
+  Ring* ring = get_ring();
+  std::lock_guard<std::mutex> lock(rings_mutex_);
+  ring->thread_name = name;
+}
+
+MujocoTracer::Ring* MujocoTracer::get_ring()
+{
+  if (thread_ring.tracer_id == id_)
+  {
+    return static_cast<Ring*>(thread_ring.ring);
+  }
+
+  auto ring = std::make_unique<Ring>();
+  char thread_name[16] = "";
+  pthread_getname_np(pthread_self(), thread_name, sizeof(thread_name));
+  ring->thread_name = thread_name;
+  ring->events = std::make_unique<Event[]>(events_per_thread_);
+  ring->capacity = events_per_thread_;
+
+  std::lock_guard<std::mutex> lock(rings_mutex_);
+  rings_.push_back(std::move(ring));
+  thread_ring = {id_, rings_.back().get()};
+  return rings_.back().get();
+}
+
+long MujocoTracer::dump(const std::string & path) const
+{
+  std::ofstream file(path);
+  if (!file)
+  {
+    return -1;
+  }
+
+  // microseconds with nanosecond resolution, also after hours of simulation
+  file << std::fixed << std::setprecision(3);
+  std::lock_guard<std::mutex> lock(rings_mutex_);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  long event_count = 0;
+  struct EventCopy
+  {
+    const char* name;
+    int64_t start;
+    int64_t duration;
+  };
+  std::vector<EventCopy> events;
+  for (size_t tid = 0; tid < rings_.size(); tid++)
+  {
+    const auto& ring = *rings_[tid];
+    file << (tid > 0 ? "," : "") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+         << ",\"args\":{\"name\":\"" << ring.thread_name << "\"}}";
+
+    // the owning thread keeps recording, so copy first and then drop what it overwrote meanwhile
+    uint64_t capacity = ring.capacity;
+    uint64_t end = ring.count.load(std::memory_order_acquire);
+    uint64_t begin = end > capacity ? end - capacity : 0;
+    events.clear();
+    for (uint64_t i = begin; i < end; i++)
+    {
+      const auto& event = ring.events[i % capacity];
+      events.push_back({
+        event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed),
+        event.duration.load(std::memory_order_relaxed)});
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t overwritten_end = ring.count.load(std::memory_order_relaxed);
+    uint64_t first_valid = overwritten_end >= capacity ? overwritten_end - capacity + 1 : 0;
+
+    for (uint64_t i = std::max(begin, first_valid); i < end; i++)
+    {
+      const auto& event = events[i - begin];
+      file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+           << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+      event_count++;
+    }
+  }
+  file << "\n]}\n";
+  return file ? event_count : -1;
+}
+}  // namespace mujoco_ros2_control
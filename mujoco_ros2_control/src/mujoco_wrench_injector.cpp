@@ -0,0 +1,89 @@
+#include "mujoco_ros2_control/mujoco_wrench_injector.hpp"
+
+namespace mujoco_ros2_control
+{
+MujocoWrenchInjector::MujocoWrenchInjector(
+  rclcpp::Node::SharedPtr & node, const mjModel* mujoco_model, mjData* mujoco_data, size_t queue_size)
+  : logger_(rclcpp::get_logger(node->get_name() + std::string(".wrench_injector"))),
+    mj_model_(mujoco_model), mj_data_(mujoco_data), queue_(queue_size)
+{
+  wrenches_.reserve(queue_size);
+
+  // not added to the node's default executor, MujocoRos2Control spins it on its services executor
+  callback_group_ = node->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+  rclcpp::SubscriptionOptions options;
+  options.callback_group = callback_group_;
+  wrench_subscription_ = node->create_subscription<mujoco_ros2_control_msgs::msg::BodyWrench>(
+    "~/body_wrench", rclcpp::QoS(queue_size),
+    [this](const mujoco_ros2_control_msgs::msg::BodyWrench::SharedPtr msg) { wrench_callback(msg); },
+    options);
+}
+
+rclcpp::CallbackGroup::SharedPtr MujocoWrenchInjector::get_callback_group() const
+{
+  return callback_group_;
+}
+
+void MujocoWrenchInjector::wrench_callback(const mujoco_ros2_control_msgs::msg::BodyWrench::SharedPtr msg)
+{
+  TimedWrench timed_wrench;
+  timed_wrench.body_id = mj_name2id(mj_model_, mjtObj::mjOBJ_BODY, msg->body.c_str());
+  if (timed_wrench.body_id == -1)
+  {
+    RCLCPP_ERROR_STREAM(logger_, "Failed to find body in mujoco model, body name: " << msg->body);
+    return;
+  }
+  timed_wrench.wrench[0] = msg->wrench.force.x;
+  timed_wrench.wrench[1] = msg->wrench.force.y;
+  timed_wrench.wrench[2] = msg->wrench.force.z;
+  timed_wrench.wrench[3] = msg->wrench.torque.x;
+  timed_wrench.wrench[4] = msg->wrench.torque.y;
+  timed_wrench.wrench[5] = msg->wrench.torque.z;
+  timed_wrench.start = msg->start.sec == 0 && msg->start.nanosec == 0 ? -1.0 :
+    msg->start.sec + msg->start.nanosec * 1e-9;
+  timed_wrench.duration = msg->duration.sec + msg->duration.nanosec * 1e-9;
+
+  if (!queue_.push(timed_wrench))
+  {
+    RCLCPP_WARN_STREAM(logger_, "Wrench queue is full, dropping wrench for body: " << msg->body);
+  }
+}
+
+void MujocoWrenchInjector::update()
+{
+  double time = mj_data_->time;
+
+  TimedWrench timed_wrench;
+  while (wrenches_.size() < wrenches_.capacity() && queue_.pop(timed_wrench))
+  {
+    if (timed_wrench.start < 0.0)
+    {
+      timed_wrench.start = time;
+    }
+    wrenches_.push_back(timed_wrench);
+  }
+
+  for (size_t i = 0; i < wrenches_.size();)
+  {
+    const auto& wrench = wrenches_[i];
+    if (wrench.start > time)
+    {
+      i++;
+      continue;
+    }
+
+    mju_addTo(mj_data_->xfrc_applied + 6 * wrench.body_id, wrench.wrench, 6);
+
+    // the wrench acts during [time, time + timestep), drop it after its last step
+    if (time + mj_model_->opt.timestep >= wrench.start + wrench.duration)
+    {
+      wrenches_[i] = wrenches_.back();
+      wrenches_.pop_back();
+    }
+    else
+    {
+      i++;
+    }
+  }
+}
+}  // namespace mujoco_ros2_control
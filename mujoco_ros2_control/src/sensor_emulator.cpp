@@ -0,0 +1,155 @@
+#include "mujoco_ros2_control/sensor_emulator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mujoco_ros2_control
+{
+bool SensorModel::is_enabled() const
+{
+  return noise_stddev > 0.0 || bias_drift > 0.0 || quantization > 0.0 || delay > 0.0 || delay_jitter > 0.0;
+}
+
+SensorModel SensorModel::from_parameters(
+  const std::unordered_map<std::string, std::string> & parameters, const std::string & prefix)
+{
+  auto get = [&parameters, &prefix](const std::string & name)
+  {
+    auto parameter = parameters.find(prefix + "_" + name);
+    return parameter != parameters.end() ? std::stod(parameter->second) : 0.0;
+  };
+
+  SensorModel model;
+  model.noise_stddev = get("noise_stddev");
+  model.bias_drift = get("bias_drift");
+  model.quantization = get("quantization");
+  model.delay = get("delay");
+  model.delay_jitter = get("delay_jitter");
+  return model;
+}
+
+SensorEmulator::SensorEmulator()
+  : normal_(0.0, 1.0), uniform_(0.0, 1.0), last_time_(std::numeric_limits<double>::lowest())
+{
+}
+
+void SensorEmulator::add(double* value, const SensorModel & model, double sample_period)
+{
+  Channel channel;
+  channel.value = value;
+  channel.model = model;
+  channel.bias = 0.0;
+  channel.head = 0;
+  channel.count = 0;
+  channel.last_output_time = std::numeric_limits<double>::lowest();
+  channel.last_output = 0.0;
+  channel.begin = samples_.size();
+  channel.capacity = static_cast<size_t>(std::ceil((model.delay + model.delay_jitter) / sample_period)) + 2;
+  channels_.push_back(channel);
+  samples_.resize(samples_.size() + channel.capacity);
+  random_numbers_.resize(3 * channels_.size());
+}
+
+bool SensorEmulator::empty() const
+{
+  return channels_.empty();
+}
+
+void SensorEmulator::reset(uint64_t seed)
+{
+  engine_.seed(seed);
+  normal_.reset();
+  uniform_.reset();
+  last_time_ = std::numeric_limits<double>::lowest();
+  for (auto& channel : channels_)
+  {
+    channel.bias = 0.0;
+    channel.head = 0;
+    channel.count = 0;
+    channel.last_output_time = std::numeric_limits<double>::lowest();
+    channel.last_output = 0.0;
+  }
+}
+
+void SensorEmulator::apply(double time, double period)
+{
+  // the simulation went back in time, the delayed readings belong to another run
+  if (time < last_time_)
+  {
+    for (auto& channel : channels_)
+    {
+      channel.bias = 0.0;
+      channel.count = 0;
+      channel.last_output_time = std::numeric_limits<double>::lowest();
+    }
+  }
+  last_time_ = time;
+
+  // draw every number each time, so that the sequence does not depend on the sensor models
+  for (size_t i = 0; i < channels_.size(); i++)
+  {
+    random_numbers_[3 * i] = normal_(engine_);
+    random_numbers_[3 * i + 1] = normal_(engine_);
+    random_numbers_[3 * i + 2] = uniform_(engine_);
+  }
+
+  double sqrt_period = std::sqrt(std::max(period, 0.0));
+  for (size_t i = 0; i < channels_.size(); i++)
+  {
+    auto& channel = channels_[i];
+    const auto& model = channel.model;
+    double value = *channel.value;
+    if (model.delay > 0.0 || model.delay_jitter > 0.0)
+    {
+      value = delay(channel, time, value, model.delay_jitter * random_numbers_[3 * i + 2]);
+    }
+    channel.bias += model.bias_drift * sqrt_period * random_numbers_[3 * i + 1];
+    value += channel.bias + model.noise_stddev * random_numbers_[3 * i];
+    if (model.quantization > 0.0)
+    {
+      value = std::round(value / model.quantization) * model.quantization;
+    }
+    *channel.value = value;
+  }
+}
+
+double SensorEmulator::delay(Channel & channel, double time, double value, double jitter)
+{
+  // append the reading, overwriting the oldest one when the line is full
+  size_t tail = (channel.head + channel.count) % channel.capacity;
+  if (channel.count == channel.capacity)
+  {
+    channel.head = (channel.head + 1) % channel.capacity;
+  }
+  else
+  {
+    channel.count++;
+  }
+  samples_[channel.begin + tail] = {time, value};
+
+  // the newest reading which is old enough
+  double target = time - channel.model.delay - jitter;
+  for (size_t i = channel.count; i-- > 0;)
+  {
+    const auto& sample = samples_[channel.begin + (channel.head + i) % channel.capacity];
+    if (sample.time <= target)
+    {
+      // readings arrive in order, a longer random delay holds the last one instead of going back
+      if (sample.time >= channel.last_output_time)
+      {
+        channel.last_output_time = sample.time;
+        channel.last_output = sample.value;
+      }
+      return channel.last_output;
+    }
+  }
+  // nothing is old enough for a longer random delay, hold the last output, or the first reading
+  // right after the start
+  if (channel.last_output_time != std::numeric_limits<double>::lowest())
+  {
+    return channel.last_output;
+  }
+  return samples_[channel.begin + channel.head].value;
+}
+}  // namespace mujoco_ros2_control
@@ -0,0 +1,198 @@
+#include "mujoco_ros2_control/step_budget_watchdog.hpp"
+
+#include "mujoco_ros2_control/mujoco_model_options.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace mujoco_ros2_control
+{
+namespace
+{
+const char* LEVEL_NAMES[] = {"nominal", "skip_rendering", "reduce_clock", "cheap_solver"};
+
+double seconds(std::chrono::steady_clock::duration duration)
+{
+  return std::chrono::duration<double>(duration).count();
+}
+}  // namespace
+
+StepBudgetWatchdog::StepBudgetWatchdog(
+  rclcpp::Node::SharedPtr & node, mjModel* mujoco_model, mjData* mujoco_data, MujocoRos2Control & control,
+  double frame_period)
+  : logger_(rclcpp::get_logger(node->get_name() + std::string(".step_budget_watchdog"))), clock_(node->get_clock()),
+    mj_model_(mujoco_model), mj_data_(mujoco_data), control_(control), frame_period_(frame_period),
+    level_(NOMINAL),
+    window_start_sim_time_(mujoco_data->time), window_step_time_(0.0), window_max_step_time_(0.0), window_steps_(0),
+    window_step_overruns_(0), window_frame_overruns_(0), window_skipped_frames_(0), total_step_overruns_(0),
+    total_frame_overruns_(0), frame_count_(0)
+{
+  degrade_ = node->get_parameter_or<bool>("watchdog_degrade", false);
+  min_real_time_factor_ = node->get_parameter_or<double>("watchdog_min_real_time_factor", 0.9);
+  report_period_ = node->get_parameter_or<double>("watchdog_report_period", 1.0);
+  clock_decimation_ = node->get_parameter_or<int>("watchdog_clock_decimation", 10);
+  threads_ = node->get_parameter_or<int>("mujoco_threads", 0);
+
+  original_iterations_ = mj_model_->opt.iterations;
+  original_ls_iterations_ = mj_model_->opt.ls_iterations;
+
+  diagnostics_publisher_ = node->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("/diagnostics", 10);
+  diagnostics_msg_.status.resize(1);
+  auto& status = diagnostics_msg_.status.at(0);
+  status.name = node->get_name() + std::string(": step budget");
+  status.hardware_id = "mujoco";
+  for (const auto& key : {"real_time_factor", "load", "steps", "mean_step_time", "max_step_time",
+    "step_overruns", "frame_overruns", "skipped_frames", "total_step_overruns", "total_frame_overruns",
+    "degradation_level", "solver", "solver_iterations", "ls_iterations", "noslip_iterations", "island",
+    "mujoco_threads"})
+  {
+    diagnostic_msgs::msg::KeyValue value;
+    value.key = key;
+    status.values.push_back(value);
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  step_start_ = now;
+  frame_start_ = now;
+  window_start_ = now;
+}
+
+void StepBudgetWatchdog::begin_step()
+{
+  step_start_ = std::chrono::steady_clock::now();
+}
+
+void StepBudgetWatchdog::end_step()
+{
+  double step_time = seconds(std::chrono::steady_clock::now() - step_start_);
+  window_step_time_ += step_time;
+  window_max_step_time_ = std::max(window_max_step_time_, step_time);
+  window_steps_++;
+  // a step is over budget when it takes longer than the simulated time it advances
+  if (step_time > mj_model_->opt.timestep)
+  {
+    window_step_overruns_++;
+    total_step_overruns_++;
+  }
+}
+
+bool StepBudgetWatchdog::end_frame()
+{
+  auto now = std::chrono::steady_clock::now();
+  // the frame covers the previous rendering and the simulation of this one, so missing one
+  // v-sync shows up as a frame which takes about twice the period
+  if (seconds(now - frame_start_) > 1.5 * frame_period_)
+  {
+    window_frame_overruns_++;
+    total_frame_overruns_++;
+  }
+  frame_count_++;
+
+  bool render = level_ < SKIP_RENDERING || frame_count_ % 2 == 0;
+  if (!render)
+  {
+    window_skipped_frames_++;
+    // without rendering, nothing waits for v-sync, so keep the loop from running ahead of real time
+    std::this_thread::sleep_until(frame_start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(frame_period_)));
+    now = std::chrono::steady_clock::now();
+  }
+  frame_start_ = now;
+
+  if (seconds(now - window_start_) >= report_period_)
+  {
+    end_window(now);
+  }
+  return render;
+}
+
+void StepBudgetWatchdog::end_window(std::chrono::steady_clock::time_point now)
+{
+  double wall_time = seconds(now - window_start_);
+  double real_time_factor = (mj_data_->time - window_start_sim_time_) / wall_time;
+  // fraction of the wall time spent stepping the simulation
+  double load = window_step_time_ / wall_time;
+  publish_diagnostics(real_time_factor, load);
+
+  if (degrade_)
+  {
+    if (real_time_factor < min_real_time_factor_ && level_ < CHEAP_SOLVER)
+    {
+      set_degradation_level(level_ + 1);
+    }
+    else if (real_time_factor >= min_real_time_factor_ && load < 0.5 && level_ > NOMINAL)
+    {
+      set_degradation_level(level_ - 1);
+    }
+  }
+
+  window_start_ = now;
+  window_start_sim_time_ = mj_data_->time;
+  window_step_time_ = 0.0;
+  window_max_step_time_ = 0.0;
+  window_steps_ = 0;
+  window_step_overruns_ = 0;
+  window_frame_overruns_ = 0;
+  window_skipped_frames_ = 0;
+}
+
+void StepBudgetWatchdog::set_degradation_level(int level)
+{
+  level_ = level;
+  control_.set_clock_decimation(level_ >= REDUCE_CLOCK ? clock_decimation_ : 1);
+  apply_solver_degradation();
+  RCLCPP_WARN_STREAM(logger_, "Simulation degradation level changed to " << LEVEL_NAMES[level_]);
+}
+
+void StepBudgetWatchdog::apply_solver_degradation()
+{
+  if (level_ >= CHEAP_SOLVER)
+  {
+    mj_model_->opt.iterations = std::max(1, original_iterations_ / 2);
+    mj_model_->opt.ls_iterations = std::max(1, original_ls_iterations_ / 2);
+  }
+  else
+  {
+    mj_model_->opt.iterations = original_iterations_;
+    mj_model_->opt.ls_iterations = original_ls_iterations_;
+  }
+}
+
+void StepBudgetWatchdog::set_model(mjModel* mujoco_model, mjData* mujoco_data)
+{
+  mj_model_ = mujoco_model;
+  mj_data_ = mujoco_data;
+  original_iterations_ = mj_model_->opt.iterations;
+  original_ls_iterations_ = mj_model_->opt.ls_iterations;
+  apply_solver_degradation();
+}
+
+void StepBudgetWatchdog::publish_diagnostics(double real_time_factor, double load)
+{
+  auto& status = diagnostics_msg_.status.at(0);
+  status.level = real_time_factor < min_real_time_factor_ ? diagnostic_msgs::msg::DiagnosticStatus::WARN :
+    diagnostic_msgs::msg::DiagnosticStatus::OK;
+  status.message = level_ == NOMINAL ? "running at full fidelity" : std::string("degraded: ") + LEVEL_NAMES[level_];
+  double mean_step_time = window_steps_ > 0 ? window_step_time_ / window_steps_ : 0.0;
+  status.values.at(0).value = std::to_string(real_time_factor);
+  status.values.at(1).value = std::to_string(load);
+  status.values.at(2).value = std::to_string(window_steps_);
+  status.values.at(3).value = std::to_string(mean_step_time);
+  status.values.at(4).value = std::to_string(window_max_step_time_);
+  status.values.at(5).value = std::to_string(window_step_overruns_);
+  status.values.at(6).value = std::to_string(window_frame_overruns_);
+  status.values.at(7).value = std::to_string(window_skipped_frames_);
+  status.values.at(8).value = std::to_string(total_step_overruns_);
+  status.values.at(9).value = std::to_string(total_frame_overruns_);
+  status.values.at(10).value = LEVEL_NAMES[level_];
+  // the solver options of the model as currently stepped, including degradation
+  status.values.at(11).value = get_solver_name(mj_model_->opt.solver);
+  status.values.at(12).value = std::to_string(mj_model_->opt.iterations);
+  status.values.at(13).value = std::to_string(mj_model_->opt.ls_iterations);
+  status.values.at(14).value = std::to_string(mj_model_->opt.noslip_iterations);
+  status.values.at(15).value = (mj_model_->opt.enableflags & mjtEnableBit::mjENBL_ISLAND) ? "on" : "off";
+  status.values.at(16).value = std::to_string(threads_);
+  diagnostics_msg_.header.stamp = clock_->now();
+  diagnostics_publisher_->publish(diagnostics_msg_);
+}
+}  // namespace mujoco_ros2_control
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "mujoco_ros2_control/actuator_dynamics.hpp"
+
+using mujoco_ros2_control::ActuatorDynamics;
+using mujoco_ros2_control::ActuatorModel;
+
+namespace
+{
+constexpr double timestep = 0.001;
+constexpr double unlimited = std::numeric_limits<double>::max();
+}  // namespace
+
+TEST(ActuatorDynamics, DelaysByWholeSteps)
+{
+  ActuatorModel model;
+  model.delay = 0.005;
+  double output = 0.0;
+  ActuatorDynamics dynamics;
+  size_t channel = dynamics.add(&output, model, -unlimited, unlimited, timestep);
+
+  *dynamics.get_input(channel) = 1.0;
+  for (int step = 0; step < 5; step++)
+  {
+    dynamics.apply();
+    EXPECT_EQ(output, 0.0) << "at step " << step;
+  }
+  dynamics.apply();
+  EXPECT_EQ(output, 1.0);
+}
+
+TEST(ActuatorDynamics, LagStepResponse)
+{
+  ActuatorModel model;
+  model.time_constant = 0.1;
+  double output = 0.0;
+  ActuatorDynamics dynamics;
+  size_t channel = dynamics.add(&output, model, -unlimited, unlimited, timestep);
+
+  *dynamics.get_input(channel) = 1.0;
+  double previous = 0.0;
+  for (int step = 1; step <= 1000; step++)
+  {
+    dynamics.apply();
+    EXPECT_GT(output, previous);
+    EXPECT_LT(output, 1.0);
+    previous = output;
+    if (step == 100)
+    {
+      // one time constant, within the error of the implicit discretization
+      EXPECT_NEAR(output, 1.0 - std::exp(-1.0), 0.01);
+    }
+  }
+  EXPECT_NEAR(output, 1.0, 1e-4);
+}
+
+TEST(ActuatorDynamics, SlewStepResponse)
+{
+  ActuatorModel model;
+  model.rate_limit = 2.0;
+  double output = 0.0;
+  ActuatorDynamics dynamics;
+  size_t channel = dynamics.add(&output, model, -unlimited, unlimited, timestep);
+
+  *dynamics.get_input(channel) = 1.0;
+  for (int step = 1; step <= 600; step++)
+  {
+    dynamics.apply();
+    EXPECT_NEAR(output, std::min(2.0 * step * timestep, 1.0), 1e-9) << "at step " << step;
+  }
+
+  *dynamics.get_input(channel) = -1.0;
+  for (int step = 1; step <= 100; step++)
+  {
+    dynamics.apply();
+  }
+  EXPECT_NEAR(output, 0.8, 1e-9);
+}
+
+TEST(ActuatorDynamics, SaturatesCommands)
+{
+  ActuatorModel model;
+  double output = 0.0;
+  ActuatorDynamics dynamics;
+  size_t channel = dynamics.add(&output, model, -0.5, 0.5, timestep);
+
+  *dynamics.get_input(channel) = 2.0;
+  dynamics.apply();
+  EXPECT_EQ(output, 0.5);
+  *dynamics.get_input(channel) = -2.0;
+  dynamics.apply();
+  EXPECT_EQ(output, -0.5);
+}
+
+TEST(ActuatorDynamics, ResetStartsOverFromValue)
+{
+  ActuatorModel model;
+  model.time_constant = 0.05;
+  model.delay = 0.003;
+  double output = 0.0;
+  ActuatorDynamics dynamics;
+  size_t channel = dynamics.add(&output, model, -unlimited, unlimited, timestep);
+
+  *dynamics.get_input(channel) = 1.0;
+  for (int step = 0; step < 50; step++)
+  {
+    dynamics.apply();
+  }
+  dynamics.reset(channel, -1.0);
+  *dynamics.get_input(channel) = -1.0;
+  for (int step = 0; step < 10; step++)
+  {
+    dynamics.apply();
+    EXPECT_EQ(output, -1.0);
+  }
+}
+
+TEST(ActuatorDynamics, RecoversFromNanCommands)
+{
+  ActuatorModel lagged;
+  lagged.time_constant = 0.01;
+  lagged.rate_limit = 10.0;
+  double outputs[2] = {0.0, 0.0};
+  ActuatorDynamics dynamics;
+  size_t neutral_channel = dynamics.add(&outputs[0], ActuatorModel(), -unlimited, unlimited, timestep);
+  size_t lagged_channel = dynamics.add(&outputs[1], lagged, -unlimited, unlimited, timestep);
+
+  *dynamics.get_input(neutral_channel) = std::numeric_limits<double>::quiet_NaN();
+  *dynamics.get_input(lagged_channel) = std::numeric_limits<double>::quiet_NaN();
+  dynamics.apply();
+  EXPECT_TRUE(std::isnan(outputs[0]));
+  EXPECT_TRUE(std::isnan(outputs[1]));
+
+  *dynamics.get_input(neutral_channel) = 0.3;
+  *dynamics.get_input(lagged_channel) = 0.3;
+  dynamics.apply();
+  EXPECT_EQ(outputs[0], 0.3);
+  EXPECT_EQ(outputs[1], 0.3);
+  for (int step = 0; step < 10; step++)
+  {
+    dynamics.apply();
+    EXPECT_EQ(outputs[0], 0.3);
+    EXPECT_TRUE(std::isfinite(outputs[1]));
+  }
+}
+
+TEST(ActuatorDynamics, NeutralChannelsPassCommandsThrough)
+{
+  double output = 1e16;
+  ActuatorDynamics dynamics;
+  size_t channel = dynamics.add(&output, ActuatorModel(), -unlimited, unlimited, timestep);
+
+  // state + (command - state) would round to 0 here
+  *dynamics.get_input(channel) = 1.0;
+  dynamics.apply();
+  EXPECT_EQ(output, 1.0);
+}
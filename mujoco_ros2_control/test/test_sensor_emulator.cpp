@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "mujoco_ros2_control/sensor_emulator.hpp"
+
+using mujoco_ros2_control::SensorEmulator;
+using mujoco_ros2_control::SensorModel;
+
+namespace
+{
+// a power of two, so that times and delays are exact
+constexpr double period = 1.0 / 1024.0;
+
+// Feeds the step index as reading and returns the emulated readings
+std::vector<double> run(SensorEmulator & emulator, double & reading, int steps)
+{
+  std::vector<double> outputs;
+  for (int step = 0; step < steps; step++)
+  {
+    reading = step;
+    emulator.apply(step * period, period);
+    outputs.push_back(reading);
+  }
+  return outputs;
+}
+}  // namespace
+
+TEST(SensorEmulator, DelaysByWholeSamples)
+{
+  SensorModel model;
+  model.delay = 10 * period;
+  double reading = 0.0;
+  SensorEmulator emulator;
+  emulator.add(&reading, model, period);
+  emulator.reset(0);
+
+  auto outputs = run(emulator, reading, 100);
+  for (int step = 0; step < 10; step++)
+  {
+    // nothing is old enough yet, the first reading is held
+    EXPECT_EQ(outputs[step], 0.0);
+  }
+  for (int step = 10; step < 100; step++)
+  {
+    EXPECT_EQ(outputs[step], step - 10);
+  }
+}
+
+TEST(SensorEmulator, JitterNeverReordersReadings)
+{
+  SensorModel model;
+  model.delay = 2 * period;
+  model.delay_jitter = 20 * period;
+  double reading = 0.0;
+  SensorEmulator emulator;
+  emulator.add(&reading, model, period);
+  emulator.reset(1);
+
+  auto outputs = run(emulator, reading, 2000);
+  bool delayed_by_jitter = false;
+  for (int step = 1; step < 2000; step++)
+  {
+    EXPECT_GE(outputs[step], outputs[step - 1]) << "at step " << step;
+    // never newer than the fixed delay allows, the first reading is held right after the start
+    EXPECT_LE(outputs[step], std::max(step - 2, 0));
+    delayed_by_jitter |= outputs[step] < step - 2;
+  }
+  EXPECT_TRUE(delayed_by_jitter);
+}
+
+TEST(SensorEmulator, QuantizesReadings)
+{
+  SensorModel model;
+  model.quantization = 0.25;
+  double reading = 0.0;
+  SensorEmulator emulator;
+  emulator.add(&reading, model, period);
+  emulator.reset(0);
+
+  reading = 1.1;
+  emulator.apply(0.0, period);
+  EXPECT_EQ(reading, 1.0);
+  reading = 1.2;
+  emulator.apply(period, period);
+  EXPECT_EQ(reading, 1.25);
+}
+
+TEST(SensorEmulator, SameSeedReproducesReadings)
+{
+  SensorModel model;
+  model.noise_stddev = 0.1;
+  model.bias_drift = 0.5;
+  model.delay = 2 * period;
+  model.delay_jitter = 5 * period;
+
+  auto emulate = [&model](uint64_t seed)
+    {
+      std::vector<double> readings(3, 0.0);
+      SensorEmulator emulator;
+      for (auto& reading : readings)
+      {
+        emulator.add(&reading, model, period);
+      }
+      emulator.reset(seed);
+
+      std::vector<double> outputs;
+      for (int step = 0; step < 500; step++)
+      {
+        for (auto& reading : readings)
+        {
+          reading = step;
+        }
+        emulator.apply(step * period, period);
+        outputs.insert(outputs.end(), readings.begin(), readings.end());
+      }
+      return outputs;
+    };
+
+  EXPECT_EQ(emulate(7), emulate(7));
+  EXPECT_NE(emulate(7), emulate(8));
+}
+
+TEST(SensorEmulator, ResetRestartsTheSequence)
+{
+  SensorModel model;
+  model.noise_stddev = 0.1;
+  double reading = 0.0;
+  SensorEmulator emulator;
+  emulator.add(&reading, model, period);
+
+  emulator.reset(3);
+  auto first = run(emulator, reading, 100);
+  emulator.reset(3);
+  auto second = run(emulator, reading, 100);
+  EXPECT_EQ(first, second);
+}
@@ -0,0 +1,43 @@
+import os
+
+from ament_index_python.packages import get_package_share_directory
+
+
+from launch import LaunchDescription
+
+from launch_ros.actions import Node
+
+import xacro
+
+
+def generate_launch_description():
+    mujoco_ros2_control_demos_path = os.path.join(
+        get_package_share_directory('mujoco_ros2_control_demos'))
+
+    xacro_file = os.path.join(mujoco_ros2_control_demos_path,
+                              'urdf',
+                              'test_vertical_cart_position_pid.xacro.urdf')
+
+    doc = xacro.parse(open(xacro_file))
+    xacro.process_doc(doc)
+    robot_description = {'robot_description': doc.toxml()}
+
+    controller_config_file = os.path.join(mujoco_ros2_control_demos_path, 'config', 'cartpole_controller_position.yaml')
+
+    node_mujoco_ros2_control_batch = Node(
+        package='mujoco_ros2_control',
+        executable='mujoco_ros2_control_batch',
+        output='screen',
+        parameters=[
+            robot_description,
+            controller_config_file,
+            {'mujoco_model_path':os.path.join(mujoco_ros2_control_demos_path, 'mujoco_models', 'test_vertical_cart.xml')},
+            {'controllers': ['joint_state_broadcaster', 'joint_trajectory_controller'],
+             'duration': 10.0,
+             'metrics_path': 'vertical_cart_metrics.yaml'}
+        ]
+    )
+
+    return LaunchDescription([
+        node_mujoco_ros2_control_batch
+    ])
@@ -0,0 +1,41 @@
+import os
+
+from ament_index_python.packages import get_package_share_directory
+
+
+from launch import LaunchDescription
+
+from launch_ros.actions import Node
+
+import xacro
+
+
+def generate_launch_description():
+    mujoco_ros2_control_demos_path = os.path.join(
+        get_package_share_directory('mujoco_ros2_control_demos'))
+
+    xacro_file = os.path.join(mujoco_ros2_control_demos_path,
+                              'urdf',
+                              'test_vertical_cart_position_pid.xacro.urdf')
+
+    doc = xacro.parse(open(xacro_file))
+    xacro.process_doc(doc)
+    robot_description = {'robot_description': doc.toxml()}
+
+    controller_config_file = os.path.join(mujoco_ros2_control_demos_path, 'config', 'cartpole_controller_sweep.yaml')
+
+    node_mujoco_ros2_control_sweep = Node(
+        package='mujoco_ros2_control',
+        executable='mujoco_ros2_control_sweep',
+        output='screen',
+        parameters=[
+            robot_description,
+            controller_config_file,
+            {'mujoco_model_path':os.path.join(mujoco_ros2_control_demos_path, 'mujoco_models', 'test_vertical_cart.xml')},
+            {'sweep_config_path':os.path.join(mujoco_ros2_control_demos_path, 'config', 'vertical_cart_sweep.yaml')}
+        ]
+    )
+
+    return LaunchDescription([
+        node_mujoco_ros2_control_sweep
+    ])